@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+#
+# Generates a synthetic corpus of .proto files for benchmarking.
+#
+# The corpus is spread over a number of packages. Each file imports the
+# previous file in its package and has messages with nested messages and
+# enums, fields of all scalar types, proto2 defaults and extensions,
+# services and doc comments of several paragraphs.
+#
+# Usage: benchmark/corpus.py [--files N] [--messages N] [--packages N] OUT_DIR
+
+import argparse
+import os
+import random
+
+SCALAR_TYPES = [
+    'double', 'float', 'int32', 'int64', 'uint32', 'uint64', 'sint32', 'sint64',
+    'fixed32', 'fixed64', 'sfixed32', 'sfixed64', 'bool', 'string', 'bytes',
+]
+
+WORDS = (
+    'vehicle booking customer account order payment invoice address route '
+    'station schedule driver fleet region status request response record '
+    'entry value amount total count limit window policy token session'
+).split()
+
+
+def comment(rng, indent, paragraphs):
+    """Returns a doc comment of the given number of paragraphs."""
+    lines = []
+    for i in range(paragraphs):
+        if i:
+            lines.append('')
+        for _ in range(rng.randint(1, 3)):
+            lines.append(' '.join(rng.choice(WORDS) for _ in range(rng.randint(6, 12))).capitalize() + '.')
+    if len(lines) == 1:
+        return '%s/** %s */\n' % (indent, lines[0])
+    body = ''.join('%s * %s\n' % (indent, line) if line else '%s *\n' % indent for line in lines)
+    return '%s/**\n%s%s */\n' % (indent, body, indent)
+
+
+def default(rng, type_):
+    """Returns a default value option for a proto2 field of the given type, or ''."""
+    if rng.random() < 0.7:
+        return ''
+    if type_ == 'bool':
+        return ' [default = true]'
+    if type_ in ('string', 'bytes'):
+        return ' [default = "%s"]' % rng.choice(WORDS)
+    if type_ in ('double', 'float'):
+        return ' [default = %.2f]' % rng.uniform(-100, 100)
+    if type_.startswith('u') or type_ == 'fixed32' or type_ == 'fixed64':
+        return ' [default = %d]' % rng.randint(0, 1000)
+    return ' [default = %d]' % rng.randint(-1000, 1000)
+
+
+def message(rng, name, proto2, indent, depth, types):
+    """Returns the definition of a message, with nested types if depth allows."""
+    out = comment(rng, indent, rng.randint(1, 3))
+    out += '%smessage %s {\n' % (indent, name)
+    inner = indent + '    '
+    local = []
+    if depth > 0 and rng.random() < 0.5:
+        out += enum(rng, name + 'Kind', inner)
+        local.append(name + 'Kind')
+    if depth > 0 and rng.random() < 0.4:
+        out += message(rng, name + 'Part', proto2, inner, depth - 1, types)
+        local.append(name + 'Part')
+    for number in range(1, rng.randint(4, 16)):
+        type_ = rng.choice(SCALAR_TYPES + local + types)
+        label = rng.choice(['optional', 'required', 'repeated']) if proto2 else rng.choice(['', 'repeated'])
+        field = '%s %s field_%d = %d' % (label, type_, number, number)
+        if proto2 and label != 'repeated' and type_ in SCALAR_TYPES:
+            field += default(rng, type_)
+        out += comment(rng, inner, 1)
+        out += '%s%s;\n' % (inner, field.strip())
+    if proto2:
+        out += '\n%sextensions 100 to max;\n' % inner
+    out += '%s}\n\n' % indent
+    return out
+
+
+def enum(rng, name, indent):
+    """Returns the definition of an enum."""
+    out = comment(rng, indent, rng.randint(1, 2))
+    out += '%senum %s {\n' % (indent, name)
+    for number in range(rng.randint(2, 8)):
+        out += '%s    %s_VALUE_%d = %d; /** %s. */\n' % (
+            indent, name.upper(), number, number, rng.choice(WORDS).capitalize())
+    out += '%s}\n\n' % indent
+    return out
+
+
+def service(rng, name, messages):
+    """Returns the definition of a service."""
+    out = comment(rng, '', 2) + 'service %s {\n' % name
+    for i in range(rng.randint(1, 6)):
+        out += comment(rng, '    ', 1)
+        out += '    rpc Call%d(%s) returns (%s);\n' % (i, rng.choice(messages), rng.choice(messages))
+    return out + '}\n\n'
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate a synthetic .proto corpus.')
+    parser.add_argument('--files', type=int, default=200, help='number of files (default: %(default)s)')
+    parser.add_argument('--messages', type=int, default=20, help='messages per file (default: %(default)s)')
+    parser.add_argument('--packages', type=int, default=10, help='number of packages (default: %(default)s)')
+    parser.add_argument('--seed', type=int, default=1, help='random seed (default: %(default)s)')
+    parser.add_argument('out', help='output directory')
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    os.makedirs(args.out, exist_ok=True)
+
+    previous = {}
+    for i in range(args.files):
+        package = 'corpus.pkg%d' % (i % args.packages)
+        fileName = 'file%d.proto' % i
+        proto2 = i % 2 == 1
+        prefix = 'F%d' % i
+
+        out = comment(rng, '', 2) + '\n'
+        out += 'syntax = "%s";\n\n' % ('proto2' if proto2 else 'proto3')
+        out += 'package %s;\n\n' % package
+
+        types = []
+        imported = previous.get(package)
+        if imported and imported[1] == proto2:
+            out += 'import "%s";\n\n' % imported[0]
+            types = imported[2]
+
+        names = []
+        for j in range(args.messages):
+            names.append('%sMessage%d' % (prefix, j))
+            out += message(rng, names[-1], proto2, '', 2, types + names[:-1])
+        out += enum(rng, prefix + 'Status', '')
+        out += service(rng, prefix + 'Service', names)
+        if proto2 and types:
+            out += comment(rng, '', 1)
+            out += 'extend %s {\n    optional string %s_note = 100;\n}\n' % (types[0], prefix.lower())
+
+        with open(os.path.join(args.out, fileName), 'w') as f:
+            f.write(out)
+        previous[package] = (fileName, proto2, names[:5])
+
+
+if __name__ == '__main__':
+    main()
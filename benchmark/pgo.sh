@@ -0,0 +1,95 @@
+#!/bin/sh
+#
+# Builds a profile-guided optimized release binary of protoc-gen-doc.
+#
+# 1. Builds a plain release binary for comparison.
+# 2. Builds an instrumented binary (CONFIG+=pgo_generate).
+# 3. Trains it on the synthetic corpus and the examples, in every built-in
+#    format.
+# 4. Rebuilds the release binary with the collected profile and link time
+#    optimization (CONFIG+=pgo_use).
+# 5. Writes a report comparing the two release binaries.
+#
+# Usage: benchmark/pgo.sh [OUT_DIR]
+#
+# OUT_DIR defaults to _pgo in the source directory. The optimized binary ends
+# up in OUT_DIR/pgo/protoc-gen-doc and the report in OUT_DIR/report.txt.
+# QMAKE, MAKE, PROTOC and JOBS can be set in the environment. Requires g++.
+
+set -e
+
+SOURCE_DIR=$(cd "$(dirname "$0")/.." && pwd)
+OUT_DIR=$(mkdir -p "${1:-$SOURCE_DIR/_pgo}" && cd "${1:-$SOURCE_DIR/_pgo}" && pwd)
+QMAKE=${QMAKE:-qmake}
+MAKE=${MAKE:-make}
+PROTOC=${PROTOC:-protoc}
+JOBS=${JOBS:-$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)}
+PROFILE_DIR=$OUT_DIR/profile
+FORMATS="docbook html markdown json"
+
+# build DIR [QMAKE_ARGS...]: Configures and builds into DIR from scratch.
+build() {
+    dir=$1
+    shift
+    mkdir -p "$dir"
+    (cd "$dir" && "$QMAKE" CONFIG+=release "$@" "$SOURCE_DIR/protoc-gen-doc.pro" &&
+        "$MAKE" clean >/dev/null && "$MAKE" -j"$JOBS")
+}
+
+# generate PLUGIN DIR OUT FORMAT: Runs PLUGIN on all protos in DIR.
+generate() {
+    (cd "$2" && "$PROTOC" -I. --plugin=protoc-gen-doc="$1" \
+        --doc_out="$4,out.$4:$3" *.proto)
+}
+
+# elapsed COMMAND...: Prints the wall-clock time of COMMAND in milliseconds.
+elapsed() {
+    start=$(date +%s%N)
+    "$@"
+    end=$(date +%s%N)
+    echo $(( (end - start) / 1000000 ))
+}
+
+echo "Generating corpus..."
+rm -rf "$OUT_DIR/corpus" "$OUT_DIR/output"
+"$SOURCE_DIR/benchmark/corpus.py" "$OUT_DIR/corpus"
+mkdir -p "$OUT_DIR/output"
+
+echo "Building release binary..."
+build "$OUT_DIR/release"
+
+# The instrumented and the optimized binary are built in the same directory,
+# since the profile files are named after the object file paths.
+echo "Building instrumented binary..."
+rm -rf "$PROFILE_DIR"
+build "$OUT_DIR/pgo" CONFIG+=pgo_generate PGO_PROFILE_DIR="$PROFILE_DIR"
+
+echo "Training..."
+for format in $FORMATS; do
+    generate "$OUT_DIR/pgo/protoc-gen-doc" "$OUT_DIR/corpus" "$OUT_DIR/output" "$format"
+    generate "$OUT_DIR/pgo/protoc-gen-doc" "$SOURCE_DIR/examples/proto" "$OUT_DIR/output" "$format"
+done
+
+echo "Building optimized binary..."
+build "$OUT_DIR/pgo" CONFIG+=pgo_use PGO_PROFILE_DIR="$PROFILE_DIR"
+
+echo "Comparing..."
+REPORT=$OUT_DIR/report.txt
+{
+    echo "protoc-gen-doc PGO comparison on $(ls "$OUT_DIR/corpus" | wc -l) corpus files"
+    echo "Best of 5 runs, in milliseconds"
+    echo
+    printf '%-10s %10s %10s %8s\n' format release pgo speedup
+    for format in $FORMATS; do
+        best_release=
+        best_pgo=
+        for run in 1 2 3 4 5; do
+            t=$(elapsed generate "$OUT_DIR/release/protoc-gen-doc" "$OUT_DIR/corpus" "$OUT_DIR/output" "$format")
+            [ -z "$best_release" ] || [ "$t" -lt "$best_release" ] && best_release=$t
+            t=$(elapsed generate "$OUT_DIR/pgo/protoc-gen-doc" "$OUT_DIR/corpus" "$OUT_DIR/output" "$format")
+            [ -z "$best_pgo" ] || [ "$t" -lt "$best_pgo" ] && best_pgo=$t
+        done
+        printf '%-10s %10s %10s %7sx\n' "$format" "$best_release" "$best_pgo" \
+            "$(awk "BEGIN { printf \"%.2f\", $best_release / ($best_pgo ? $best_pgo : 1) }")"
+    done
+} | tee "$REPORT"
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+#
+# Measures the startup time of protoc-gen-doc.
+#
+# Feeds the plugin a minimal CodeGeneratorRequest holding a single empty
+# .proto file and measures the time from starting the process until the first
+# byte of the response arrives on its standard output.
+#
+# Usage: benchmark/startup.py [--plugin PATH] [--format FORMAT] [--runs N]
+
+import argparse
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def field(number, payload):
+    """Encodes a length-delimited protobuf field."""
+    size = len(payload)
+    varint = bytearray()
+    while True:
+        byte = size & 0x7f
+        size >>= 7
+        varint.append(byte | (0x80 if size else 0))
+        if not size:
+            break
+    return bytes([number << 3 | 2]) + bytes(varint) + payload
+
+
+def request(fileName, parameter):
+    """Returns a CodeGeneratorRequest for the empty file fileName."""
+    fileProto = field(1, fileName.encode()) + field(12, b'proto3')
+    return field(1, fileName.encode()) + field(2, parameter.encode()) + field(15, fileProto)
+
+
+def main():
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    parser = argparse.ArgumentParser(description='Measure protoc-gen-doc startup time.')
+    parser.add_argument('--plugin', default=os.path.join(root, 'protoc-gen-doc'),
+                        help='plugin executable (default: %(default)s)')
+    parser.add_argument('--format', default='json',
+                        help='output format (default: %(default)s)')
+    parser.add_argument('--runs', type=int, default=100,
+                        help='number of runs (default: %(default)s)')
+    args = parser.parse_args()
+
+    data = request('empty.proto', args.format + ',out')
+    workDir = tempfile.mkdtemp()
+    with open(os.path.join(workDir, 'empty.proto'), 'w') as f:
+        f.write('syntax = "proto3";\n')
+
+    times = []
+    for _ in range(args.runs):
+        start = time.perf_counter()
+        process = subprocess.Popen([args.plugin], cwd=workDir,
+                                   stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        process.stdin.write(data)
+        process.stdin.close()
+        first = process.stdout.read(1)
+        elapsed = time.perf_counter() - start
+        process.stdout.read()
+        if process.wait() != 0 or not first:
+            sys.exit('%s failed' % args.plugin)
+        times.append(elapsed * 1000)
+
+    times.sort()
+    print('%s, %s format, %d runs' % (args.plugin, args.format, args.runs))
+    print('time to first byte: min %.2f ms, median %.2f ms, p90 %.2f ms' %
+          (times[0], statistics.median(times), times[int(len(times) * 0.9)]))
+
+
+if __name__ == '__main__':
+    main()
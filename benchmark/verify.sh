@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Verifies that the value engine renders exactly what the legacy variant engine
+# (src/legacy, the renderer and model from before the protocdoc library) renders.
+#
+# Runs the plugin with engine=verify on the examples and a synthetic corpus,
+# in every built-in format and with the example templates. Each run fails
+# with the location of the first differing byte if the outputs differ, and
+# otherwise reports the time taken by each engine.
+#
+# Usage: benchmark/verify.sh [PLUGIN [OUT_DIR]]
+#
+# PLUGIN defaults to protoc-gen-doc in the source directory, and OUT_DIR to
+# _verify in the source directory. PROTOC can be set in the environment.
+
+set -e
+
+# Generate in-process, so that the reports end up on stderr here.
+unset PROTOC_GEN_DOC_SOCKET
+
+SOURCE_DIR=$(cd "$(dirname "$0")/.." && pwd)
+PLUGIN=$(cd "$(dirname "${1:-$SOURCE_DIR/protoc-gen-doc}")" && pwd)/$(basename "${1:-protoc-gen-doc}")
+OUT_DIR=$(mkdir -p "${2:-$SOURCE_DIR/_verify}" && cd "${2:-$SOURCE_DIR/_verify}" && pwd)
+PROTOC=${PROTOC:-protoc}
+TEMPLATES="docbook html markdown $(ls "$SOURCE_DIR"/examples/templates/*.mustache)"
+
+echo "Generating corpus..."
+rm -rf "$OUT_DIR/corpus" "$OUT_DIR/output"
+"$SOURCE_DIR/benchmark/corpus.py" "$OUT_DIR/corpus"
+mkdir -p "$OUT_DIR/output"
+
+# verify DIR TEMPLATE: Runs the plugin on all protos in DIR with both engines.
+failed=0
+verify() {
+    if ! (cd "$1" && "$PROTOC" -I. --plugin=protoc-gen-doc="$PLUGIN" \
+            --doc_out="$2,out.txt,engine=verify:$OUT_DIR/output" *.proto); then
+        failed=1
+    fi
+}
+
+for template in $TEMPLATES; do
+    verify "$SOURCE_DIR/examples/proto" "$template"
+    verify "$OUT_DIR/corpus" "$template"
+done
+
+if [ $failed -ne 0 ]; then
+    echo "The engines differ."
+    exit 1
+fi
+echo "The engines agree."
@@ -1,12 +1,18 @@
 TEMPLATE = app
 VERSION = 0.9
 
-CONFIG += console c++11
+CONFIG += console c++17
 CONFIG -= app_bundle
 QT -= gui
 
-HEADERS += src/mustache.h
-SOURCES += src/mustache.cpp src/main.cpp
+include(src/protocdoc/protocdoc.pri)
+
+HEADERS += src/generator.h src/outputwriter.h src/pluginmain.h src/session.h
+SOURCES += src/generator.cpp src/main.cpp src/outputwriter.cpp src/pluginmain.cpp src/session.cpp
+
+# The legacy engine, for engine=variant and engine=verify.
+HEADERS += src/legacy/legacy.h src/legacy/mustache.h
+SOURCES += src/legacy/legacy.cpp src/legacy/mustache.cpp
 RESOURCES += protoc-gen-doc.qrc
 
 isEmpty(PREFIX):PREFIX = /usr/local
@@ -14,6 +20,13 @@ target.path = $$PREFIX/bin
 INSTALLS += target
 
 lessThan(QT_MAJOR_VERSION, 5):error(This program requires Qt 5.x.)
+!versionAtLeast(QT_VERSION, 5.12.0):error(This program requires Qt 5.12 or later.)
+
+unix {
+    # The generation daemon uses Unix domain sockets.
+    HEADERS += src/daemon.h src/socketserver.h
+    SOURCES += src/daemon.cpp src/socketserver.cpp
+}
 
 linux {
     # Use pkg-config to find libprotobuf.
@@ -21,6 +34,14 @@ linux {
     PKGCONFIG = protobuf
 
     LIBS += -lprotoc # Has no .pc, so add manually.
+
+    # Lua filters, if Lua 5.3 is installed.
+    packagesExist(lua5.3) {
+        DEFINES += HAVE_LUA
+        PKGCONFIG += lua5.3
+        HEADERS += src/luafilters.h
+        SOURCES += src/luafilters.cpp
+    }
 }
 
 msvc|mac {
@@ -52,6 +73,28 @@ mac {
     LIBS += -L$${PROTOBUF_PREFIX}/lib -lprotobuf -lprotoc
 }
 
+# Profile-guided optimization (g++ only), driven by benchmark/pgo.sh. Build
+# with CONFIG+=pgo_generate to collect a profile in PGO_PROFILE_DIR, and then
+# with CONFIG+=pgo_use in the same build directory to optimize with it.
+pgo_generate|pgo_use {
+    isEmpty(PGO_PROFILE_DIR):PGO_PROFILE_DIR = $$OUT_PWD/profile
+}
+pgo_generate {
+    QMAKE_CXXFLAGS += -fprofile-generate=$$PGO_PROFILE_DIR
+    QMAKE_LFLAGS += -fprofile-generate=$$PGO_PROFILE_DIR
+}
+pgo_use {
+    QMAKE_CXXFLAGS += -fprofile-use=$$PGO_PROFILE_DIR -fprofile-correction -Wno-missing-profile -flto
+    QMAKE_LFLAGS += -fprofile-use=$$PGO_PROFILE_DIR -flto
+}
+
+unix {
+    # Run "make pgo" to build a profile-guided optimized binary in ./_pgo/pgo.
+    pgo.commands = $$PWD/benchmark/pgo.sh $$OUT_PWD/_pgo
+    pgo.CONFIG = phony
+    QMAKE_EXTRA_TARGETS += pgo
+}
+
 # Increase g++ warnings.
 *g++*:QMAKE_CXXFLAGS += -Werror -Wall -Wextra
 
@@ -0,0 +1,97 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "../generator.h"
+#include "../protocdoc/mustache.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/compiler/importer.h>
+#include <google/protobuf/descriptor.h>
+
+/**
+ * A set of .proto files rendered into one output file.
+ */
+struct PackageSet {
+    std::string outputFileName;                         /**< Output file, relative to the output directory. */
+    std::vector<std::string> protoFileNames;            /**< Files to document, relative to the proto path. */
+    std::vector<const google::protobuf::FileDescriptor *> fileDescriptors; /**< Imported descriptors of the files. */
+};
+
+/**
+ * Options given on the command line.
+ */
+struct BatchOptions {
+    std::vector<std::string> protoPaths;    /**< Directories searched for imports. */
+    std::vector<std::string> descriptorSets; /**< Descriptor sets to load instead of parsing files. */
+    std::string format = "html";            /**< Template format or file name. */
+    std::string outputDirectory = ".";      /**< Directory output files are written to. */
+    bool noExclude = false;                 /**< Ignore @exclude directives? */
+    bool collapseWhitespace = false;        /**< Collapse whitespace in template markup? */
+    bool incremental = false;               /**< Only regenerate outputs that may have changed? */
+    bool watch = false;                     /**< Regenerate when files change? */
+    bool serve = false;                     /**< Serve the documentation over HTTP instead of writing it? */
+    unsigned servePort = 0;                 /**< Port to serve on, 0 for any free port. */
+    unsigned jobs = 0;                      /**< Number of worker threads, 0 for one per core. */
+    Mustache::RenderLimits renderLimits;    /**< Limits on rendering each set. */
+    bool memoize = false;                   /**< Memoize repeated sections when rendering? */
+    RenderEngine engine = RenderEngine::Value; /**< Engine rendering the templates. */
+    std::string luaScript;                  /**< Lua script defining template filters, if any. */
+    Mustache::Value filters;                /**< Template filters loaded from luaScript. */
+    std::vector<PackageSet> sets;           /**< Package sets to render. */
+};
+
+/**
+ * Error collector printing parse errors in the format of protoc.
+ */
+class ErrorPrinter : public google::protobuf::compiler::MultiFileErrorCollector
+{
+public:
+    /// Implements google::protobuf::compiler::MultiFileErrorCollector.
+    void AddError(const std::string &fileName, int line, int column, const std::string &message) override
+    {
+        print(fileName, line, column, message);
+    }
+
+    /// Implements google::protobuf::compiler::MultiFileErrorCollector.
+    void AddWarning(const std::string &fileName, int line, int column, const std::string &message) override
+    {
+        print(fileName, line, column, "warning: " + message);
+    }
+
+private:
+    void print(const std::string &fileName, int line, int column, const std::string &message)
+    {
+        std::cerr << fileName;
+        if (line >= 0) {
+            // Lines and columns are zero-based.
+            std::cerr << ":" << line + 1 << ":" << column + 1;
+        }
+        std::cerr << ": " << message << std::endl;
+    }
+};
+
+/**
+ * Renders the extracted @p files of the package set @p set into its output file.
+ * The legacy engine, if selected, renders @p legacyFiles instead (see
+ * renderDocument()).
+ *
+ * @return true on success, otherwise false.
+ */
+bool writeDocument(const PackageSet &set, const BatchOptions &options, const Mustache::Template &template_,
+                   Mustache::Value files, std::string *error, const QVariantList *legacyFiles = nullptr);
@@ -0,0 +1,254 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+#include "incremental.h"
+
+#include "../protocdoc/manifest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include <google/protobuf/descriptor.h>
+
+namespace gp = google::protobuf;
+
+/// First line of a state file, changed whenever the format changes.
+static const char *stateHeader = "protoc-gen-doc-batch state 1";
+
+/**
+ * Returns the "long" name of the message or enum described by @p descriptor,
+ * i.e. its name preceded by the names of its enclosing messages.
+ */
+template<typename T>
+static std::string longName(const T *descriptor)
+{
+    if (!descriptor->containing_type()) {
+        return descriptor->name();
+    }
+    return longName(descriptor->containing_type()) + "." + descriptor->name();
+}
+
+/**
+ * Returns the hash of the parts of the message or enum @p descriptor that
+ * documentation referring to it uses, i.e. its names.
+ */
+template<typename T>
+static std::string signatureOf(const char *kind, const T *descriptor)
+{
+    return protocdoc::contentHash(std::string(kind) + " " + descriptor->full_name() + " " + longName(descriptor));
+}
+
+/**
+ * Returns the signature of the message or enum @p typeName declared in the
+ * file @p fileDescriptor, or an empty string if the file declares no such type.
+ */
+static std::string signatureOf(const gp::FileDescriptor *fileDescriptor, const std::string &typeName)
+{
+    const gp::DescriptorPool *pool = fileDescriptor->pool();
+    if (const gp::Descriptor *descriptor = pool->FindMessageTypeByName(typeName)) {
+        return descriptor->file() == fileDescriptor ? signatureOf("message", descriptor) : std::string();
+    }
+    if (const gp::EnumDescriptor *descriptor = pool->FindEnumTypeByName(typeName)) {
+        return descriptor->file() == fileDescriptor ? signatureOf("enum", descriptor) : std::string();
+    }
+    return std::string();
+}
+
+/**
+ * Collects the types from other files referred to by the documented files.
+ */
+class ReferenceCollector
+{
+public:
+    explicit ReferenceCollector(const std::vector<const gp::FileDescriptor *> &fileDescriptors)
+        : m_files(fileDescriptors.begin(), fileDescriptors.end())
+    {
+        for (const gp::FileDescriptor *fileDescriptor : fileDescriptors) {
+            for (int i = 0; i < fileDescriptor->message_type_count(); ++i) {
+                addMessage(fileDescriptor->message_type(i));
+            }
+            for (int i = 0; i < fileDescriptor->extension_count(); ++i) {
+                addField(fileDescriptor->extension(i));
+            }
+            for (int i = 0; i < fileDescriptor->service_count(); ++i) {
+                const gp::ServiceDescriptor *serviceDescriptor = fileDescriptor->service(i);
+                for (int j = 0; j < serviceDescriptor->method_count(); ++j) {
+                    add("message", serviceDescriptor->method(j)->input_type());
+                    add("message", serviceDescriptor->method(j)->output_type());
+                }
+            }
+        }
+    }
+
+    /// Referred types by full name, with their files and signatures.
+    std::map<std::string, std::pair<const gp::FileDescriptor *, std::string>> references;
+
+private:
+    void addMessage(const gp::Descriptor *descriptor)
+    {
+        for (int i = 0; i < descriptor->field_count(); ++i) {
+            addField(descriptor->field(i));
+        }
+        for (int i = 0; i < descriptor->extension_count(); ++i) {
+            addField(descriptor->extension(i));
+        }
+        for (int i = 0; i < descriptor->nested_type_count(); ++i) {
+            addMessage(descriptor->nested_type(i));
+        }
+    }
+
+    void addField(const gp::FieldDescriptor *fieldDescriptor)
+    {
+        if (fieldDescriptor->message_type()) {
+            add("message", fieldDescriptor->message_type());
+        } else if (fieldDescriptor->enum_type()) {
+            add("enum", fieldDescriptor->enum_type());
+        }
+        if (fieldDescriptor->is_extension()) {
+            add("message", fieldDescriptor->containing_type());
+        }
+    }
+
+    template<typename T>
+    void add(const char *kind, const T *descriptor)
+    {
+        if (!m_files.count(descriptor->file())) {
+            references.emplace(descriptor->full_name(), std::make_pair(descriptor->file(), signatureOf(kind, descriptor)));
+        }
+    }
+
+    std::set<const gp::FileDescriptor *> m_files;
+};
+
+void IncrementalState::load(const std::string &path, const std::string &configuration)
+{
+    m_configuration = configuration;
+    m_outputs.clear();
+
+    std::ifstream stream(path);
+    std::string line;
+    if (!std::getline(stream, line) || line != stateHeader ||
+            !std::getline(stream, line) || line != configuration) {
+        return;
+    }
+
+    // The remaining lines are tab-separated records:
+    //   O  output file
+    //   F  documented file, hash
+    //   R  referring file, hash, type name, signature
+    Output *output = nullptr;
+    while (std::getline(stream, line)) {
+        std::vector<std::string> fields;
+        std::istringstream lineStream(line);
+        for (std::string field; std::getline(lineStream, field, '\t'); ) {
+            fields.push_back(field);
+        }
+        if (fields.size() == 2 && fields[0] == "O") {
+            output = &m_outputs[fields[1]];
+        } else if (fields.size() == 3 && fields[0] == "F" && output) {
+            output->files.emplace_back(fields[1], fields[2]);
+        } else if (fields.size() == 5 && fields[0] == "R" && output) {
+            output->references.push_back({ fields[1], fields[2], fields[3], fields[4] });
+        } else {
+            // Corrupt, start over.
+            m_outputs.clear();
+            return;
+        }
+    }
+}
+
+bool IncrementalState::save(const std::string &path) const
+{
+    // Write to a temporary file first, so that an interrupted run leaves the
+    // old state in place.
+    const std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream stream(temporaryPath, std::ios::out | std::ios::trunc);
+        stream << stateHeader << '\n' << m_configuration << '\n';
+        for (const auto &output : m_outputs) {
+            stream << "O\t" << output.first << '\n';
+            for (const auto &file : output.second.files) {
+                stream << "F\t" << file.first << '\t' << file.second << '\n';
+            }
+            for (const Reference &reference : output.second.references) {
+                stream << "R\t" << reference.fileName << '\t' << reference.fileHash << '\t'
+                       << reference.typeName << '\t' << reference.signature << '\n';
+            }
+        }
+        if (!stream.flush()) {
+            return false;
+        }
+    }
+    std::error_code errorCode;
+    std::filesystem::rename(temporaryPath, path, errorCode);
+    return !errorCode;
+}
+
+bool IncrementalState::isUpToDate(const PackageSet &set, const std::string &outputPath,
+                                  const FileHasher &hashOf, const FileFinder &findFile)
+{
+    auto it = m_outputs.find(set.outputFileName);
+    if (it == m_outputs.end() || it->second.files.size() != set.protoFileNames.size()) {
+        return false;
+    }
+    Output &output = it->second;
+
+    std::error_code errorCode;
+    if (!std::filesystem::exists(outputPath, errorCode)) {
+        return false;
+    }
+
+    // The documented files must be unchanged.
+    for (size_t i = 0; i < output.files.size(); ++i) {
+        if (output.files[i].first != set.protoFileNames[i] ||
+                output.files[i].second.empty() || hashOf(output.files[i].first) != output.files[i].second) {
+            return false;
+        }
+    }
+
+    // Referred types must be unchanged, which only needs checking in changed files.
+    for (Reference &reference : output.references) {
+        const std::string fileHash = hashOf(reference.fileName);
+        if (!fileHash.empty() && fileHash == reference.fileHash) {
+            continue;
+        }
+        const gp::FileDescriptor *fileDescriptor = fileHash.empty() ? nullptr : findFile(reference.fileName);
+        if (!fileDescriptor || signatureOf(fileDescriptor, reference.typeName) != reference.signature) {
+            return false;
+        }
+        reference.fileHash = fileHash;
+    }
+
+    return true;
+}
+
+void IncrementalState::record(const PackageSet &set, const FileHasher &hashOf)
+{
+    Output output;
+    for (const gp::FileDescriptor *fileDescriptor : set.fileDescriptors) {
+        output.files.emplace_back(fileDescriptor->name(), hashOf(fileDescriptor->name()));
+    }
+    ReferenceCollector collector(set.fileDescriptors);
+    for (const auto &reference : collector.references) {
+        const std::string &fileName = reference.second.first->name();
+        output.references.push_back({ fileName, hashOf(fileName), reference.first, reference.second.second });
+    }
+    m_outputs[set.outputFileName] = std::move(output);
+}
+
+void IncrementalState::forget(const PackageSet &set)
+{
+    m_outputs.erase(set.outputFileName);
+}
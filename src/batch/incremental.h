@@ -0,0 +1,99 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+#pragma once
+
+#include "batch.h"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace protobuf {
+class FileDescriptor;
+}
+}
+
+/**
+ * Dependency and type reference graph of the outputs written by earlier runs.
+ *
+ * For each output, the state records the hashes of the files documented in it,
+ * and the types from other files that the documented files refer to, along with
+ * the parts of those types that end up in the output. An output is up to date if
+ * its own files are unchanged and every referenced type either lives in an
+ * unchanged file or still looks the same, so that changing a shared file only
+ * re-renders the outputs whose content refers to what changed.
+ */
+class IncrementalState
+{
+public:
+    /// Returns the hash of a file, or an empty string if it can't be read.
+    typedef std::function<std::string(const std::string &fileName)> FileHasher;
+
+    /// Returns the descriptor of a file, or nullptr if it can't be loaded.
+    typedef std::function<const google::protobuf::FileDescriptor *(const std::string &fileName)> FileFinder;
+
+    /**
+     * Loads the state from @p path.
+     *
+     * The state is only used if it was saved with the same @p configuration,
+     * which identifies everything besides the files affecting the outputs. A
+     * missing or unreadable state is treated as empty.
+     */
+    void load(const std::string &path, const std::string &configuration);
+
+    /**
+     * Saves the state to @p path.
+     *
+     * @return true on success, otherwise false.
+     */
+    bool save(const std::string &path) const;
+
+    /**
+     * Returns true if the output of @p set, written to @p outputPath, is up to
+     * date. Files holding changed referenced types are loaded with @p findFile.
+     */
+    bool isUpToDate(const PackageSet &set, const std::string &outputPath,
+                    const FileHasher &hashOf, const FileFinder &findFile);
+
+    /**
+     * Records the output of @p set as written from its file descriptors. The
+     * files are hashed right away, so @p hashOf is not kept.
+     */
+    void record(const PackageSet &set, const FileHasher &hashOf);
+
+    /**
+     * Forgets the output of @p set, e.g. because writing it failed.
+     */
+    void forget(const PackageSet &set);
+
+private:
+    /// A type referred to from another file.
+    struct Reference {
+        std::string fileName;   /**< File declaring the type. */
+        std::string fileHash;   /**< Hash of that file when the reference was checked. */
+        std::string typeName;   /**< Full name of the type. */
+        std::string signature;  /**< Hash of the parts of the type used in the output. */
+    };
+
+    /// An output and what it was generated from.
+    struct Output {
+        std::vector<std::pair<std::string, std::string>> files; /**< Documented files and their hashes. */
+        std::vector<Reference> references;                       /**< Types referred to from other files. */
+    };
+
+    std::string m_configuration;
+    std::map<std::string, Output> m_outputs;
+};
@@ -0,0 +1,687 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+/*
+ * protoc-gen-doc-batch: generates documentation for many package sets without
+ * protoc. All .proto files are parsed once into a shared descriptor pool, and
+ * the sets are then extracted and rendered in parallel with one compiled
+ * template. Alternatively, the descriptors are loaded from prebuilt descriptor
+ * sets, so that no .proto file is parsed at all.
+ */
+
+#include "batch.h"
+#include "incremental.h"
+#include "../generator.h"
+#include "../legacy/legacy.h"
+#include "../protocdoc/manifest.h"
+#include "../protocdoc/model.h"
+#include "../protocdoc/mustache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <QFile>
+#include <QIODevice>
+
+#ifdef HAVE_LUA
+#include "../luafilters.h"
+#endif
+
+#ifdef Q_OS_UNIX
+#include "serve.h"
+#endif
+
+#ifdef Q_OS_LINUX
+#include "watch.h"
+#endif
+
+#include <google/protobuf/arena.h>
+#include <google/protobuf/compiler/importer.h>
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/descriptor.pb.h>
+
+namespace gp = google::protobuf;
+namespace ms = Mustache;
+
+/// Name of the state file of incremental runs in the output directory.
+static const char *stateFileName = ".protoc-gen-doc-batch.state";
+
+/**
+ * Error collector printing errors found while building descriptors from a
+ * descriptor set.
+ */
+class PoolErrorPrinter : public gp::DescriptorPool::ErrorCollector
+{
+public:
+    /// Implements google::protobuf::DescriptorPool::ErrorCollector.
+    void AddError(const std::string &fileName, const std::string &elementName, const gp::Message *,
+                  ErrorLocation, const std::string &message) override
+    {
+        std::cerr << fileName << ": " << elementName << ": " << message << std::endl;
+    }
+};
+
+/**
+ * Returns a usage help string.
+ */
+static std::string usage()
+{
+    return "Usage: protoc-gen-doc-batch [OPTION]... OUT_FILE=PROTO_FILE[,PROTO_FILE]...|@LIST_FILE...\n"
+           "\n"
+           "Generates one documentation file per package set, parsing all .proto files\n"
+           "once and rendering the sets in parallel.\n"
+           "\n"
+           "Options:\n"
+           "  -I, --proto_path=PATH  Directory to search for imports (repeatable,\n"
+           "                         defaults to the current directory).\n"
+           "  --descriptor_set_in=FILE\n"
+           "                         Load descriptors from a FileDescriptorSet built with\n"
+           "                         protoc --include_source_info instead of parsing .proto\n"
+           "                         files (repeatable). File names are as given to protoc.\n"
+           "  --engine=ENGINE        Render with the value (default) or the legacy variant\n"
+           "                         engine, or verify that both give the same output.\n"
+           "  --format=FORMAT        " + supportedFormats().join("|").toStdString() + "|json|<TEMPLATE_FILENAME>\n"
+           "                         |module=<LIBRARY>\n"
+           "                         (default: html).\n"
+           "  --out=DIR              Output directory (default: current directory).\n"
+           "  --collapse-whitespace  Collapse indentation in the markup of the template.\n"
+           "  --incremental          Only regenerate outputs whose content may have changed\n"
+           "                         since the last run, as recorded in OUT_DIR/" + std::string(stateFileName) + ".\n"
+           "  --no-exclude           Ignore @exclude directives.\n"
+           "  -j, --jobs=N           Number of worker threads (default: one per core).\n"
+#ifdef HAVE_LUA
+           "  --lua=FILE             Lua script returning a table of template filters.\n"
+#endif
+           "  --max-depth=N          Maximum nesting depth of sections and partials\n"
+           "                         (default: 256, 0 for no limit).\n"
+           "  --max-output=BYTES     Maximum size of an output file (default: no limit).\n"
+           "  --memoize              Reuse the output of sections rendered with the same\n"
+           "                         values.\n"
+#ifdef Q_OS_UNIX
+           "  --serve=PORT           Serve the documentation on http://127.0.0.1:PORT/,\n"
+           "                         rendering each page when it is requested, instead\n"
+           "                         of writing it. Port 0 picks a free port.\n"
+#endif
+           "  --time-budget=MS       Maximum time to render an output file in milliseconds\n"
+           "                         (default: no limit).\n"
+#ifdef Q_OS_LINUX
+           "  --watch                Keep running, and regenerate the outputs affected by\n"
+           "                         changes to the .proto files.\n"
+#endif
+           "\n"
+           "A list file holds one package set per line. Empty lines and lines starting\n"
+           "with # are ignored.\n";
+}
+
+/**
+ * Splits @p text at each @p separator.
+ */
+static std::vector<std::string> split(const std::string &text, char separator)
+{
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (true) {
+        const size_t end = text.find(separator, start);
+        parts.push_back(text.substr(start, end - start));
+        if (end == std::string::npos) {
+            return parts;
+        }
+        start = end + 1;
+    }
+}
+
+/**
+ * Parses the package set @p spec of the form OUT_FILE=PROTO_FILE[,PROTO_FILE]...
+ *
+ * @return true on success, otherwise false.
+ */
+static bool parsePackageSet(const std::string &spec, PackageSet *set, std::string *error)
+{
+    const size_t pos = spec.find('=');
+    if (pos == std::string::npos || pos == 0 || pos + 1 == spec.size()) {
+        *error = spec + ": Expected OUT_FILE=PROTO_FILE[,PROTO_FILE]...";
+        return false;
+    }
+    set->outputFileName = spec.substr(0, pos);
+    set->protoFileNames = split(spec.substr(pos + 1), ',');
+    if (std::find(set->protoFileNames.begin(), set->protoFileNames.end(), std::string()) !=
+            set->protoFileNames.end()) {
+        *error = spec + ": Empty file name";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Reads package sets from the list file @p fileName into @p options.
+ *
+ * @return true on success, otherwise false.
+ */
+static bool readListFile(const std::string &fileName, BatchOptions *options, std::string *error)
+{
+    std::ifstream stream(fileName);
+    if (!stream) {
+        *error = fileName + ": Failed to open";
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(stream, line)) {
+        ++lineNumber;
+        line.erase(0, line.find_first_not_of(" \t\r"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        PackageSet set;
+        if (!parsePackageSet(line, &set, error)) {
+            *error = fileName + ":" + std::to_string(lineNumber) + ": " + *error;
+            return false;
+        }
+        options->sets.push_back(std::move(set));
+    }
+    return true;
+}
+
+/**
+ * Parses the non-negative number @p text into @p number.
+ *
+ * @return true on success, otherwise false.
+ */
+static bool parseNumber(const std::string &text, unsigned long long *number)
+{
+    char *end = nullptr;
+    errno = 0;
+    *number = std::strtoull(text.c_str(), &end, 10);
+    return !text.empty() && text[0] != '-' && *end == '\0' && errno == 0;
+}
+
+/**
+ * Parses the command line arguments into @p options.
+ *
+ * @return true on success, otherwise false.
+ */
+static bool parseArguments(int argc, char *argv[], BatchOptions *options, std::string *error)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg(argv[i]);
+
+        // Returns the value of an option given as "-x VALUE", "-xVALUE" or "--name=VALUE".
+        auto value = [&](const std::string &prefix, std::string *result) {
+            if (arg.compare(0, prefix.size(), prefix) != 0) {
+                return false;
+            }
+            if (arg.size() > prefix.size()) {
+                *result = arg.substr(prefix.size());
+            } else if (prefix.back() != '=' && i + 1 < argc) {
+                *result = argv[++i];
+            } else {
+                *error = arg + ": Missing value";
+            }
+            return true;
+        };
+
+        std::string optionValue;
+        if (value("--proto_path=", &optionValue) || value("-I", &optionValue)) {
+            options->protoPaths.push_back(optionValue);
+        } else if (value("--descriptor_set_in=", &optionValue)) {
+            options->descriptorSets.push_back(optionValue);
+        } else if (value("--engine=", &optionValue)) {
+            if (error->empty() && !parseRenderEngine(optionValue, &options->engine)) {
+                *error = arg + ": Expected value, variant or verify";
+            }
+        } else if (value("--format=", &optionValue)) {
+            options->format = optionValue;
+        } else if (value("--out=", &optionValue)) {
+            options->outputDirectory = optionValue;
+        } else if (value("--jobs=", &optionValue) || value("-j", &optionValue)) {
+            if (error->empty()) {
+                char *end = nullptr;
+                const long jobs = std::strtol(optionValue.c_str(), &end, 10);
+                if (*end != '\0' || jobs < 1) {
+                    *error = arg + ": Expected a positive number of jobs";
+                }
+                options->jobs = static_cast<unsigned>(jobs);
+            }
+        } else if (value("--lua=", &optionValue)) {
+#ifdef HAVE_LUA
+            options->luaScript = optionValue;
+#else
+            *error = arg + ": Built without Lua";
+#endif
+        } else if (value("--max-depth=", &optionValue)) {
+            unsigned long long depth = 0;
+            if (error->empty() && (!parseNumber(optionValue, &depth) || depth > INT_MAX)) {
+                *error = arg + ": Expected a non-negative depth";
+            }
+            options->renderLimits.maxDepth = static_cast<int>(depth);
+        } else if (value("--max-output=", &optionValue)) {
+            unsigned long long size = 0;
+            if (error->empty() && !parseNumber(optionValue, &size)) {
+                *error = arg + ": Expected a non-negative number of bytes";
+            }
+            options->renderLimits.maxOutputSize = static_cast<size_t>(size);
+#ifdef Q_OS_UNIX
+        } else if (value("--serve=", &optionValue)) {
+            unsigned long long port = 0;
+            if (error->empty() && (!parseNumber(optionValue, &port) || port > 65535)) {
+                *error = arg + ": Expected a port number";
+            }
+            options->serve = true;
+            options->servePort = static_cast<unsigned>(port);
+#endif
+        } else if (value("--time-budget=", &optionValue)) {
+            unsigned long long milliseconds = 0;
+            if (error->empty() && (!parseNumber(optionValue, &milliseconds) || milliseconds > LLONG_MAX)) {
+                *error = arg + ": Expected a non-negative number of milliseconds";
+            }
+            options->renderLimits.timeBudget = std::chrono::milliseconds(static_cast<long long>(milliseconds));
+        } else if (arg == "--incremental") {
+            options->incremental = true;
+        } else if (arg == "--memoize") {
+            options->memoize = true;
+        } else if (arg == "--collapse-whitespace") {
+            options->collapseWhitespace = true;
+        } else if (arg == "--no-exclude") {
+            options->noExclude = true;
+#ifdef Q_OS_LINUX
+        } else if (arg == "--watch") {
+            options->watch = true;
+#endif
+        } else if (arg == "-h" || arg == "--help") {
+            *error = usage();
+        } else if (arg[0] == '@') {
+            readListFile(arg.substr(1), options, error);
+        } else if (arg[0] == '-') {
+            *error = arg + ": Unknown option\n\n" + usage();
+        } else {
+            PackageSet set;
+            if (parsePackageSet(arg, &set, error)) {
+                options->sets.push_back(std::move(set));
+            }
+        }
+
+        if (!error->empty()) {
+            return false;
+        }
+    }
+
+    if (options->sets.empty()) {
+        *error = usage();
+        return false;
+    }
+    if (options->serve && (options->watch || options->incremental)) {
+        *error = "--serve can't be combined with --watch or --incremental";
+        return false;
+    }
+    if (options->engine != RenderEngine::Value && (options->serve || options->watch || !options->luaScript.empty())) {
+        // The legacy engine has no model cache to serve or watch from, and no Lua.
+        *error = "--engine=variant and --engine=verify can't be combined with --serve, --watch or --lua";
+        return false;
+    }
+    if (options->watch && !options->descriptorSets.empty()) {
+        *error = "--watch can't be combined with --descriptor_set_in";
+        return false;
+    }
+    if (options->protoPaths.empty()) {
+        options->protoPaths.push_back(".");
+    }
+
+    return true;
+}
+
+/**
+ * Parses the descriptor sets @p fileNames on @p arena.
+ *
+ * The files are memory-mapped while parsing, and the parsed file descriptor
+ * protos are added to @p protos by name. The first proto for a name wins.
+ *
+ * @return true on success, otherwise false.
+ */
+static bool parseDescriptorSets(const std::vector<std::string> &fileNames, gp::Arena *arena,
+                                std::unordered_map<std::string, const gp::FileDescriptorProto *> *protos,
+                                std::string *error)
+{
+    for (const std::string &fileName : fileNames) {
+        QFile file(QString::fromStdString(fileName));
+        if (!file.open(QIODevice::ReadOnly)) {
+            *error = fileName + ": " + file.errorString().toStdString();
+            return false;
+        }
+        if (file.size() > INT_MAX) {
+            *error = fileName + ": File too large";
+            return false;
+        }
+
+        // An empty file can't be mapped, but is a valid empty set.
+        gp::FileDescriptorSet *set = gp::Arena::CreateMessage<gp::FileDescriptorSet>(arena);
+        if (file.size() > 0) {
+            uchar *data = file.map(0, file.size());
+            if (!data) {
+                *error = fileName + ": " + file.errorString().toStdString();
+                return false;
+            }
+            if (!set->ParseFromArray(data, static_cast<int>(file.size()))) {
+                *error = fileName + ": Failed to parse FileDescriptorSet";
+                return false;
+            }
+            file.unmap(data);
+        }
+
+        for (const gp::FileDescriptorProto &proto : set->file()) {
+            protos->emplace(proto.name(), &proto);
+        }
+    }
+    return true;
+}
+
+/**
+ * Builds the file @p fileName from @p protos into @p pool, after its imports.
+ *
+ * @return The file descriptor, or nullptr on failure.
+ */
+static const gp::FileDescriptor *buildFile(const std::string &fileName,
+                                           const std::unordered_map<std::string, const gp::FileDescriptorProto *> &protos,
+                                           gp::DescriptorPool *pool, std::string *error)
+{
+    if (const gp::FileDescriptor *fileDescriptor = pool->FindFileByName(fileName)) {
+        return fileDescriptor;
+    }
+
+    auto it = protos.find(fileName);
+    if (it == protos.end()) {
+        *error = fileName + ": File not found in descriptor sets";
+        return nullptr;
+    }
+    for (const std::string &dependency : it->second->dependency()) {
+        if (!buildFile(dependency, protos, pool, error)) {
+            return nullptr;
+        }
+    }
+
+    PoolErrorPrinter errorPrinter;
+    const gp::FileDescriptor *fileDescriptor = pool->BuildFileCollectingErrors(*it->second, &errorPrinter);
+    if (!fileDescriptor) {
+        *error = fileName + ": Failed to build descriptor";
+    }
+    return fileDescriptor;
+}
+
+bool writeDocument(const PackageSet &set, const BatchOptions &options, const ms::Template &template_,
+                   ms::Value files, std::string *error, const QVariantList *legacyFiles)
+{
+    // Render the files.
+    std::string output;
+    std::string report;
+    if (!renderDocument(template_, options.format, false, std::move(files), &output, error,
+                        options.filters, options.renderLimits, options.memoize, options.engine,
+                        legacyFiles, &report)) {
+        return false;
+    }
+    if (!report.empty()) {
+        std::cerr << set.outputFileName + ": " + report + "\n" << std::flush;
+    }
+
+    // Write output.
+    const std::filesystem::path path = std::filesystem::path(options.outputDirectory) / set.outputFileName;
+    std::error_code errorCode;
+    std::filesystem::create_directories(path.parent_path(), errorCode);
+    std::ofstream stream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!stream.write(output.data(), output.size()) || !stream.flush()) {
+        *error = path.string() + ": Failed to write";
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Renders the package set @p set into its output file.
+ *
+ * @return true on success, otherwise false.
+ */
+static bool generate(const PackageSet &set, const BatchOptions &options,
+                     const protocdoc::ExtractOptions &extractOptions,
+                     const ms::Template &template_, std::string *error)
+{
+    // Extract the files, also for the legacy engine if it renders them.
+    ms::Value files = ms::Value::list_t();
+    QVariantList legacyFiles;
+    for (const gp::FileDescriptor *fileDescriptor : set.fileDescriptors) {
+        protocdoc::addFile(fileDescriptor, extractOptions, &files, error);
+        if (error->empty() && options.engine != RenderEngine::Value) {
+            legacy::addFile(fileDescriptor, extractOptions, &legacyFiles, error);
+        }
+        if (!error->empty()) {
+            return false;
+        }
+    }
+
+    return writeDocument(set, options, template_, std::move(files), error, &legacyFiles);
+}
+
+int main(int argc, char *argv[])
+{
+    BatchOptions options;
+    std::string error;
+
+    if (!parseArguments(argc, argv, &options, &error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    // Compile the template once, it is shared by all sets.
+    ms::Template template_;
+    if (!loadTemplate(options.format, &template_, &error, options.collapseWhitespace)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+#ifdef HAVE_LUA
+    if (!options.luaScript.empty() && !loadLuaFilters(options.luaScript, &options.filters, &error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+#endif
+
+#ifdef Q_OS_LINUX
+    if (options.watch) {
+        return watch(options, template_);
+    }
+#endif
+
+    // Parse all files into one pool, so that shared imports are parsed once.
+    // With descriptor sets, the pool is built from those instead.
+    gp::compiler::DiskSourceTree sourceTree;
+    for (const std::string &protoPath : options.protoPaths) {
+        sourceTree.MapPath("", protoPath);
+    }
+    ErrorPrinter errorPrinter;
+    gp::compiler::Importer importer(&sourceTree, &errorPrinter);
+    gp::DescriptorPool pool;
+
+    // The pool copies what it needs, so the arena is freed once we are done.
+    std::unique_ptr<gp::Arena> arena(new gp::Arena);
+    std::unordered_map<std::string, const gp::FileDescriptorProto *> protos;
+    if (!options.descriptorSets.empty() &&
+            !parseDescriptorSets(options.descriptorSets, arena.get(), &protos, &error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    const IncrementalState::FileFinder findFile = [&](const std::string &fileName) {
+        if (options.descriptorSets.empty()) {
+            return importer.Import(fileName);
+        }
+        std::string buildError;
+        const gp::FileDescriptor *fileDescriptor = buildFile(fileName, protos, &pool, &buildError);
+        if (!fileDescriptor) {
+            std::cerr << buildError << std::endl;
+        }
+        return fileDescriptor;
+    };
+
+    // With --incremental, skip the sets whose outputs are up to date.
+    IncrementalState state;
+    std::unordered_map<std::string, std::string> fileHashes;
+    const IncrementalState::FileHasher hashOf = [&](const std::string &fileName) {
+        auto it = fileHashes.find(fileName);
+        if (it != fileHashes.end()) {
+            return it->second;
+        }
+        std::string hash;
+        if (!options.descriptorSets.empty()) {
+            auto proto = protos.find(fileName);
+            if (proto != protos.end()) {
+                hash = protocdoc::contentHash(proto->second->SerializeAsString());
+            }
+        } else {
+            std::string diskFileName;
+            std::ifstream stream;
+            if (sourceTree.VirtualFileToDiskFile(fileName, &diskFileName)) {
+                stream.open(diskFileName, std::ios::in | std::ios::binary);
+            }
+            std::ostringstream contents;
+            if (stream && contents << stream.rdbuf()) {
+                hash = protocdoc::contentHash(contents.str());
+            }
+        }
+        return fileHashes.emplace(fileName, hash).first->second;
+    };
+    const std::string statePath = (std::filesystem::path(options.outputDirectory) / stateFileName).string();
+    if (options.incremental) {
+        // Anything besides the files that affects the outputs.
+        std::string configuration = options.format + '\0';
+        configuration += template_.source();
+        configuration += '\0';
+        configuration += options.noExclude ? '1' : '0';
+        configuration += options.descriptorSets.empty() ? '0' : '1';
+        if (!options.luaScript.empty()) {
+            std::ifstream script(options.luaScript, std::ios::in | std::ios::binary);
+            std::ostringstream contents;
+            contents << script.rdbuf();
+            configuration += '\0';
+            configuration += contents.str();
+        }
+        state.load(statePath, protocdoc::contentHash(configuration));
+    }
+
+    std::vector<PackageSet *> pending;
+    for (PackageSet &set : options.sets) {
+        const std::string outputPath = (std::filesystem::path(options.outputDirectory) / set.outputFileName).string();
+        if (!options.incremental || !state.isUpToDate(set, outputPath, hashOf, findFile)) {
+            pending.push_back(&set);
+        }
+    }
+
+    bool ok = true;
+    for (PackageSet *set : pending) {
+        for (const std::string &protoFileName : set->protoFileNames) {
+            const gp::FileDescriptor *fileDescriptor = findFile(protoFileName);
+            if (!fileDescriptor) {
+                ok = false;
+                continue;
+            }
+            set->fileDescriptors.push_back(fileDescriptor);
+        }
+    }
+    if (!ok) {
+        return 1;
+    }
+    if (options.incremental) {
+        // Hashing reads the descriptor set protos, so do it before they are
+        // freed. Sets that fail to be written are forgotten again below.
+        for (PackageSet *set : pending) {
+            state.record(*set, hashOf);
+        }
+    }
+    arena.reset();
+
+    protocdoc::ExtractOptions extractOptions;
+    extractOptions.noExclude = options.noExclude;
+    if (options.descriptorSets.empty()) {
+        // File descriptions are read from the files found through the proto path.
+        extractOptions.diskFileName = [&sourceTree](const std::string &name) {
+            std::string diskFileName;
+            return sourceTree.VirtualFileToDiskFile(name, &diskFileName) ? diskFileName : name;
+        };
+    } else {
+        // The .proto files may be absent, so use the source info.
+        extractOptions.descriptionFromSourceInfo = true;
+    }
+
+#ifdef Q_OS_UNIX
+    if (options.serve) {
+        // All sets are pending, since --incremental is not allowed.
+        return serve(options, extractOptions, template_);
+    }
+#endif
+
+    // Extract and render the sets in parallel. The pool is complete by now and
+    // only read from, which is thread-safe.
+    unsigned jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    jobs = std::min<size_t>(jobs, pending.size());
+
+    std::atomic<size_t> next(0);
+    std::vector<char> succeeded(pending.size(), false);
+    std::mutex errorMutex;
+    auto work = [&]() {
+        for (size_t i = next++; i < pending.size(); i = next++) {
+            std::string setError;
+            if (generate(*pending[i], options, extractOptions, template_, &setError)) {
+                succeeded[i] = true;
+            } else {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                std::cerr << pending[i]->outputFileName << ": " << setError << std::endl;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < jobs; ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    bool failed = false;
+    for (size_t i = 0; i < pending.size(); ++i) {
+        if (!succeeded[i]) {
+            state.forget(*pending[i]);
+            failed = true;
+        }
+    }
+    if (options.incremental && !state.save(statePath)) {
+        std::cerr << statePath << ": Failed to write" << std::endl;
+        failed = true;
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+# Standalone batch driver: parses .proto files itself instead of running as a
+# protoc plugin. QtCore is used only for the built-in templates.
+TEMPLATE = app
+TARGET = protoc-gen-doc-batch
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle
+QT -= gui
+
+include(../protocdoc/protocdoc.pri)
+
+HEADERS += ../generator.h batch.h incremental.h
+SOURCES += ../generator.cpp incremental.cpp main.cpp
+
+# The legacy engine, for --engine=variant and --engine=verify.
+HEADERS += ../legacy/legacy.h ../legacy/mustache.h
+SOURCES += ../legacy/legacy.cpp ../legacy/mustache.cpp
+RESOURCES += ../../protoc-gen-doc.qrc
+
+isEmpty(PREFIX):PREFIX = /usr/local
+target.path = $$PREFIX/bin
+INSTALLS += target
+
+!versionAtLeast(QT_VERSION, 5.12.0):error(This program requires Qt 5.12 or later.)
+
+unix {
+    # Serve mode uses TCP sockets.
+    HEADERS += serve.h ../socketserver.h
+    SOURCES += serve.cpp ../socketserver.cpp
+}
+
+linux {
+    # Watch mode uses inotify.
+    HEADERS += watch.h
+    SOURCES += watch.cpp
+
+    # Use pkg-config to find libprotobuf, which includes the .proto parser.
+    CONFIG += link_pkgconfig
+    PKGCONFIG = protobuf
+
+    # Lua filters, if Lua 5.3 is installed.
+    packagesExist(lua5.3) {
+        DEFINES += HAVE_LUA
+        PKGCONFIG += lua5.3
+        HEADERS += ../luafilters.h
+        SOURCES += ../luafilters.cpp
+    }
+
+    # std::filesystem needs its own library before g++ 9.
+    *g++*:LIBS += -lstdc++fs
+}
+
+msvc|mac {
+    # Get location of protobuf library.
+    PROTOBUF_PREFIX = $$getenv(PROTOBUF_PREFIX)
+    isEmpty(PROTOBUF_PREFIX) {
+        error(You must set the PROTOBUF_PREFIX environment variable!)
+    }
+}
+
+msvc {
+    INCLUDEPATH += "$${PROTOBUF_PREFIX}\src"
+    release:LIBS += "$${PROTOBUF_PREFIX}\vsprojects\Release\libprotobuf.lib"
+    debug:LIBS += "$${PROTOBUF_PREFIX}\vsprojects\Debug\libprotobuf.lib"
+}
+
+mac {
+    INCLUDEPATH += "$${PROTOBUF_PREFIX}/include"
+    LIBS += -L$${PROTOBUF_PREFIX}/lib -lprotobuf
+}
+
+# Increase g++ warnings.
+*g++*:QMAKE_CXXFLAGS += -Werror -Wall -Wextra
@@ -0,0 +1,618 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "serve.h"
+
+#include "../generator.h"
+#include "../socketserver.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <google/protobuf/descriptor.h>
+
+namespace gp = google::protobuf;
+namespace ms = Mustache;
+
+/// Maximum total size of the pages kept in the page cache.
+static const size_t MaxCacheSize = 128 * 1024 * 1024;
+
+/// Maximum size of the head of a request.
+static const size_t MaxRequestSize = 16 * 1024;
+
+/// Seconds a client may stall while sending its request or receiving the response.
+static const int RequestTimeout = 10;
+
+/// Template of the index page, whatever the format of the documentation.
+static const char *indexTemplate = R"(<!DOCTYPE html>
+<html>
+<head>
+<meta charset="utf-8">
+<title>Protocol Documentation</title>
+</head>
+<body>
+<h1>Protocol Documentation</h1>
+{{#sets}}
+<h2><a href="/set/{{set_path}}">{{set_name}}</a></h2>
+<ul>
+{{#set_files}}
+<li><a href="/file/{{file_path}}">{{file_name}}</a>
+{{#file_types}}
+<a href="/type/{{type_path}}">{{type_name}}</a>
+{{/file_types}}
+</li>
+{{/set_files}}
+</ul>
+{{/sets}}
+</body>
+</html>
+)";
+
+/**
+ * A page served to clients.
+ */
+struct Page {
+    std::string contentType; /**< Value of the Content-Type header. */
+    std::string body;        /**< Contents of the page. */
+};
+
+/**
+ * Cache of rendered pages by path, which drops the least recently used pages
+ * when it grows beyond a maximum size. This class is thread-safe.
+ */
+class PageCache
+{
+public:
+    explicit PageCache(size_t maxSize) : m_maxSize(maxSize), m_size(0) {}
+
+    /// Returns the page at @p path, or null if it is not cached.
+    std::shared_ptr<const Page> find(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_index.find(path);
+        if (it == m_index.end()) {
+            return nullptr;
+        }
+        // Move the page to the front, as the most recently used.
+        m_pages.splice(m_pages.begin(), m_pages, it->second);
+        return it->second->second;
+    }
+
+    /// Adds the page @p page at @p path, unless it is larger than the cache.
+    void insert(const std::string &path, std::shared_ptr<const Page> page)
+    {
+        const size_t size = path.size() + page->body.size();
+        if (size > m_maxSize) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_index.count(path)) {
+            // Rendered by another thread in the meantime.
+            return;
+        }
+        while (m_size + size > m_maxSize) {
+            const auto &oldest = m_pages.back();
+            m_size -= oldest.first.size() + oldest.second->body.size();
+            m_index.erase(oldest.first);
+            m_pages.pop_back();
+        }
+        m_pages.emplace_front(path, std::move(page));
+        m_index.emplace(path, m_pages.begin());
+        m_size += size;
+    }
+
+private:
+    typedef std::list<std::pair<std::string, std::shared_ptr<const Page>>> PageList;
+
+    std::mutex m_mutex;
+    size_t m_maxSize;
+    size_t m_size;    /**< Total size of the paths and bodies of the pages. */
+    PageList m_pages; /**< Pages, most recently used first. */
+    std::unordered_map<std::string, PageList::iterator> m_index; /**< Pages by path. */
+};
+
+/**
+ * Returns the Content-Type of a document written to @p fileName.
+ */
+static std::string contentTypeOf(const std::string &fileName)
+{
+    const size_t dot = fileName.find_last_of('.');
+    std::string extension = dot == std::string::npos ? std::string() : fileName.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (extension == "html" || extension == "htm") {
+        return "text/html; charset=utf-8";
+    } else if (extension == "xml") {
+        return "application/xml; charset=utf-8";
+    } else if (extension == "md") {
+        return "text/markdown; charset=utf-8";
+    } else if (extension == "json") {
+        return "application/json";
+    }
+    return "text/plain; charset=utf-8";
+}
+
+/**
+ * Returns @p text with the characters that may not appear in a URL path
+ * percent-encoded.
+ */
+static std::string percentEncoded(const std::string &text)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string encoded;
+    for (unsigned char c : text) {
+        if (std::isalnum(c) || std::strchr("-._~/", c)) {
+            encoded += static_cast<char>(c);
+        } else {
+            encoded += '%';
+            encoded += hex[c >> 4];
+            encoded += hex[c & 0xf];
+        }
+    }
+    return encoded;
+}
+
+/**
+ * Decodes the percent-encoded URL path @p text into @p decoded.
+ *
+ * @return true on success, false if @p text holds an invalid escape.
+ */
+static bool percentDecode(const std::string &text, std::string *decoded)
+{
+    auto digit = [](char c) {
+        return std::isdigit(static_cast<unsigned char>(c)) ? c - '0'
+             : std::isxdigit(static_cast<unsigned char>(c)) ? std::tolower(c) - 'a' + 10 : -1;
+    };
+    decoded->clear();
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '%') {
+            *decoded += text[i];
+            continue;
+        }
+        if (i + 2 >= text.size() || digit(text[i + 1]) < 0 || digit(text[i + 2]) < 0) {
+            return false;
+        }
+        *decoded += static_cast<char>(digit(text[i + 1]) * 16 + digit(text[i + 2]));
+        i += 2;
+    }
+    return true;
+}
+
+/**
+ * Returns the index entry of the type named @p fullName.
+ */
+static ms::Value typeEntry(const std::string &fullName)
+{
+    ms::Value type;
+    type["type_name"] = ms::Value::view(fullName);
+    type["type_path"] = percentEncoded(fullName);
+    return type;
+}
+
+/**
+ * Adds the index entries of the messages and enums in @p descriptor, including
+ * itself, to the list @p types.
+ */
+static void addTypeEntries(const gp::Descriptor *descriptor, ms::Value *types)
+{
+    types->append(typeEntry(descriptor->full_name()));
+    for (int i = 0; i < descriptor->nested_type_count(); ++i) {
+        addTypeEntries(descriptor->nested_type(i), types);
+    }
+    for (int i = 0; i < descriptor->enum_type_count(); ++i) {
+        types->append(typeEntry(descriptor->enum_type(i)->full_name()));
+    }
+}
+
+/**
+ * Reduces the extracted file @p file to the message, enum or service named
+ * @p fullName.
+ *
+ * @return true if the file documents that type, otherwise false.
+ */
+static bool selectType(ms::Value *file, const std::string &fullName)
+{
+    static const std::pair<const char *, const char *> lists[] = {
+        { "file_messages", "message_full_name" },
+        { "file_enums", "enum_full_name" },
+        { "file_services", "service_full_name" }
+    };
+
+    bool found = false;
+    for (const auto &list : lists) {
+        ms::Value::list_t selected;
+        if (const ms::Value *elements = file->find(list.first)) {
+            for (const ms::Value &element : elements->list()) {
+                const ms::Value *name = element.find(list.second);
+                if (name && name->text() == fullName) {
+                    selected.push_back(element);
+                }
+            }
+        }
+        found = found || !selected.empty();
+        (*file)[list.first] = std::move(selected);
+    }
+    (*file)["file_has_services"] = !(*file)["file_services"].isEmpty();
+    (*file)["file_has_extensions"] = false;
+    (*file)["file_extensions"] = ms::Value::list_t();
+    return found;
+}
+
+/**
+ * Renders the pages of the documentation on request.
+ */
+class DocServer
+{
+public:
+    DocServer(const BatchOptions &options, const protocdoc::ExtractOptions &extractOptions,
+              const ms::Template &template_)
+        : m_options(options)
+        , m_extractOptions(extractOptions)
+        , m_template(template_)
+        , m_index(indexTemplate)
+        , m_pool(nullptr)
+        , m_cache(MaxCacheSize)
+    {
+        for (const PackageSet &set : m_options.sets) {
+            m_sets.emplace(set.outputFileName, &set);
+            for (const gp::FileDescriptor *fileDescriptor : set.fileDescriptors) {
+                m_files.emplace(fileDescriptor->name(), fileDescriptor);
+                m_pool = fileDescriptor->pool();
+            }
+        }
+    }
+
+    /**
+     * Returns the page at the decoded URL path @p path.
+     *
+     * @return The HTTP status code: 200 if @p page is set to the page, otherwise
+     * 404 or 500, and @p error is set to point to an error message.
+     */
+    int page(const std::string &path, std::shared_ptr<const Page> *page, std::string *error)
+    {
+        *page = m_cache.find(path);
+        if (*page) {
+            return 200;
+        }
+
+        Page rendered;
+        const int status = render(path, &rendered, error);
+        if (status == 200) {
+            *page = std::make_shared<const Page>(std::move(rendered));
+            m_cache.insert(path, *page);
+        }
+        return status;
+    }
+
+private:
+    int render(const std::string &path, Page *page, std::string *error)
+    {
+        const std::string setPrefix = "/set/";
+        const std::string filePrefix = "/file/";
+        const std::string typePrefix = "/type/";
+
+        ms::Value files = ms::Value::list_t();
+        if (path == "/") {
+            page->contentType = "text/html; charset=utf-8";
+            return renderIndex(&page->body, error);
+        } else if (path.compare(0, setPrefix.size(), setPrefix) == 0) {
+            auto set = m_sets.find(path.substr(setPrefix.size()));
+            if (set == m_sets.end()) {
+                *error = "No such package set";
+                return 404;
+            }
+            for (const gp::FileDescriptor *fileDescriptor : set->second->fileDescriptors) {
+                if (!extract(fileDescriptor, &files, error)) {
+                    return 500;
+                }
+            }
+            page->contentType = contentTypeOf(set->second->outputFileName);
+        } else if (path.compare(0, filePrefix.size(), filePrefix) == 0) {
+            auto file = m_files.find(path.substr(filePrefix.size()));
+            if (file == m_files.end()) {
+                *error = "No such file";
+                return 404;
+            }
+            if (!extract(file->second, &files, error)) {
+                return 500;
+            }
+            page->contentType = contentTypeOf(m_options.sets.front().outputFileName);
+        } else if (path.compare(0, typePrefix.size(), typePrefix) == 0) {
+            const std::string fullName = path.substr(typePrefix.size());
+            const gp::FileDescriptor *fileDescriptor = fileOfType(fullName);
+            if (!fileDescriptor) {
+                *error = "No such type";
+                return 404;
+            }
+            ms::Value extracted = ms::Value::list_t();
+            if (!extract(fileDescriptor, &extracted, error)) {
+                return 500;
+            }
+            for (ms::Value file : extracted.list()) {
+                if (selectType(&file, fullName)) {
+                    files.append(std::move(file));
+                }
+            }
+            if (files.isEmpty()) {
+                // Excluded from the documentation.
+                *error = "No such type";
+                return 404;
+            }
+            page->contentType = contentTypeOf(m_options.sets.front().outputFileName);
+        } else {
+            *error = "No such page";
+            return 404;
+        }
+
+        std::string report;
+        if (!renderDocument(m_template, m_options.format, false, std::move(files), &page->body, error,
+                            m_options.filters, m_options.renderLimits, m_options.memoize,
+                            m_options.engine, nullptr, &report)) {
+            return 500;
+        }
+        if (!report.empty()) {
+            std::cerr << path + ": " + report + "\n" << std::flush;
+        }
+        return 200;
+    }
+
+    /**
+     * Renders the index of the package sets, their files and the types in them
+     * into @p output. The index is made from the descriptors, so no file is
+     * extracted for it.
+     */
+    int renderIndex(std::string *output, std::string *error)
+    {
+        ms::Value args;
+        ms::Value::list_t sets;
+        for (const PackageSet &set : m_options.sets) {
+            ms::Value::list_t files;
+            for (const gp::FileDescriptor *fileDescriptor : set.fileDescriptors) {
+                ms::Value types = ms::Value::list_t();
+                for (int i = 0; i < fileDescriptor->message_type_count(); ++i) {
+                    addTypeEntries(fileDescriptor->message_type(i), &types);
+                }
+                for (int i = 0; i < fileDescriptor->enum_type_count(); ++i) {
+                    types.append(typeEntry(fileDescriptor->enum_type(i)->full_name()));
+                }
+                for (int i = 0; i < fileDescriptor->service_count(); ++i) {
+                    types.append(typeEntry(fileDescriptor->service(i)->full_name()));
+                }
+
+                ms::Value file;
+                file["file_name"] = ms::Value::view(fileDescriptor->name());
+                file["file_path"] = percentEncoded(fileDescriptor->name());
+                file["file_types"] = std::move(types);
+                files.push_back(std::move(file));
+            }
+
+            ms::Value entry;
+            entry["set_name"] = set.outputFileName;
+            entry["set_path"] = percentEncoded(set.outputFileName);
+            entry["set_files"] = std::move(files);
+            sets.push_back(std::move(entry));
+        }
+        args["sets"] = std::move(sets);
+
+        ms::Renderer renderer;
+        ms::ValueContext context(args);
+        *output = renderer.render(m_index, &context);
+        if (!renderer.error().empty()) {
+            *error = renderer.error();
+            return 500;
+        }
+        return 200;
+    }
+
+    /**
+     * Returns the served file defining the message, enum or service named
+     * @p fullName, or null if there is none.
+     */
+    const gp::FileDescriptor *fileOfType(const std::string &fullName) const
+    {
+        if (!m_pool) {
+            return nullptr;
+        }
+        const gp::FileDescriptor *fileDescriptor = nullptr;
+        if (const gp::Descriptor *descriptor = m_pool->FindMessageTypeByName(fullName)) {
+            fileDescriptor = descriptor->file();
+        } else if (const gp::EnumDescriptor *enumDescriptor = m_pool->FindEnumTypeByName(fullName)) {
+            fileDescriptor = enumDescriptor->file();
+        } else if (const gp::ServiceDescriptor *serviceDescriptor = m_pool->FindServiceByName(fullName)) {
+            fileDescriptor = serviceDescriptor->file();
+        }
+        return fileDescriptor && m_files.count(fileDescriptor->name()) ? fileDescriptor : nullptr;
+    }
+
+    /**
+     * Appends the extracted @p fileDescriptor to the list @p files, extracting
+     * it if this is the first time it is needed.
+     *
+     * @return true on success, otherwise false and @p error is set to point to
+     * an error message.
+     */
+    bool extract(const gp::FileDescriptor *fileDescriptor, ms::Value *files, std::string *error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_modelMutex);
+            auto it = m_models.find(fileDescriptor);
+            if (it != m_models.end()) {
+                for (const ms::Value &file : it->second.list()) {
+                    files->append(file);
+                }
+                return true;
+            }
+        }
+
+        // Extract without holding the lock, so that other pages can be served
+        // meanwhile. The descriptors outlive the server, so the model may refer
+        // to them.
+        ms::Value extracted = ms::Value::list_t();
+        protocdoc::addFile(fileDescriptor, m_extractOptions, &extracted, error);
+        if (!error->empty()) {
+            return false;
+        }
+        for (const ms::Value &file : extracted.list()) {
+            files->append(file);
+        }
+
+        std::lock_guard<std::mutex> lock(m_modelMutex);
+        m_models.emplace(fileDescriptor, std::move(extracted));
+        return true;
+    }
+
+    const BatchOptions &m_options;
+    const protocdoc::ExtractOptions &m_extractOptions;
+    const ms::Template &m_template;
+    ms::Template m_index;                   /**< Template of the index page. */
+    const gp::DescriptorPool *m_pool;       /**< Pool of the served files. */
+    std::unordered_map<std::string, const PackageSet *> m_sets; /**< Package sets by output file name. */
+    std::unordered_map<std::string, const gp::FileDescriptor *> m_files; /**< Served files by name. */
+    std::mutex m_modelMutex;
+    std::unordered_map<const gp::FileDescriptor *, ms::Value> m_models; /**< Extracted files by descriptor. */
+    PageCache m_cache;
+};
+
+/**
+ * Sends a response with the status @p status and, unless @p head is true, the
+ * body @p body to the client @p fd.
+ */
+static void respond(int fd, int status, const std::string &contentType, const std::string &body, bool head)
+{
+    const char *reason = status == 200 ? "OK"
+                       : status == 400 ? "Bad Request"
+                       : status == 404 ? "Not Found"
+                       : status == 405 ? "Method Not Allowed"
+                       : "Internal Server Error";
+    std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+    response += "Content-Type: " + contentType + "\r\n";
+    response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    if (status == 405) {
+        response += "Allow: GET, HEAD\r\n";
+    }
+    response += "Connection: close\r\n\r\n";
+    if (sendAll(fd, response.data(), response.size()) && !head) {
+        sendAll(fd, body.data(), body.size());
+    }
+}
+
+/**
+ * Serves one request from the client @p fd with @p server.
+ */
+static void handleClient(int fd, DocServer *server)
+{
+    // Only the request line is needed, but read the whole head so that the
+    // client is not reset by closing a socket with unread data.
+    std::string request;
+    char buffer[4096];
+    while (request.find("\r\n\r\n") == std::string::npos) {
+        if (request.size() > MaxRequestSize) {
+            respond(fd, 400, "text/plain; charset=utf-8", "Request too large\n", false);
+            return;
+        }
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        } else if (received <= 0) {
+            return;
+        }
+        request.append(buffer, received);
+    }
+
+    // The request line is METHOD SP TARGET SP VERSION.
+    const std::string line = request.substr(0, request.find("\r\n"));
+    const size_t methodEnd = line.find(' ');
+    const size_t targetEnd = line.find(' ', methodEnd + 1);
+    if (methodEnd == std::string::npos || targetEnd == std::string::npos) {
+        respond(fd, 400, "text/plain; charset=utf-8", "Malformed request\n", false);
+        return;
+    }
+    const std::string method = line.substr(0, methodEnd);
+    const std::string target = line.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+    if (method != "GET" && method != "HEAD") {
+        respond(fd, 405, "text/plain; charset=utf-8", "Only GET and HEAD are supported\n", false);
+        return;
+    }
+    std::string path;
+    if (target.empty() || target[0] != '/' || !percentDecode(target.substr(0, target.find('?')), &path)) {
+        respond(fd, 400, "text/plain; charset=utf-8", "Malformed path\n", method == "HEAD");
+        return;
+    }
+
+    std::shared_ptr<const Page> page;
+    std::string error;
+    const int status = server->page(path, &page, &error);
+    if (status == 200) {
+        respond(fd, status, page->contentType, page->body, method == "HEAD");
+    } else {
+        if (status == 500) {
+            std::cerr << path << ": " << error << std::endl;
+        }
+        respond(fd, status, "text/plain; charset=utf-8", error + "\n", method == "HEAD");
+    }
+}
+
+int serve(const BatchOptions &options, const protocdoc::ExtractOptions &extractOptions,
+          const ms::Template &template_)
+{
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0) {
+        std::cerr << "socket: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    int reuse = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    // Only listen on the loopback interface, the documentation is for this machine.
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(options.servePort));
+    socklen_t addressSize = sizeof(address);
+    if (bind(server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+            listen(server, SOMAXCONN) < 0 ||
+            getsockname(server, reinterpret_cast<sockaddr *>(&address), &addressSize) < 0) {
+        std::cerr << "Port " << options.servePort << ": " << std::strerror(errno) << std::endl;
+        close(server);
+        return 1;
+    }
+    std::cerr << "Serving documentation on http://127.0.0.1:" << ntohs(address.sin_port) << "/" << std::endl;
+
+    DocServer docServer(options, extractOptions, template_);
+
+    const unsigned jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    serveConnections(server, jobs, RequestTimeout, [&docServer](int client) {
+        handleClient(client, &docServer);
+    });
+
+    close(server);
+    return 1;
+}
@@ -0,0 +1,40 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "batch.h"
+
+#include "../protocdoc/model.h"
+#include "../protocdoc/mustache.h"
+
+/**
+ * Runs the batch driver in serve mode (Unix only).
+ *
+ * Serves the documentation of the package sets in @p options over HTTP on the
+ * loopback interface, at port BatchOptions::servePort. Nothing is rendered up
+ * front: each page is rendered with @p template_ when it is requested, from the
+ * files of the sets, which are extracted with @p extractOptions when first
+ * needed and then kept. Rendered pages are kept in a cache of limited size,
+ * dropping the least recently used page first. The pages are
+ *
+ *     /                an index of the sets, files and types
+ *     /set/OUT_FILE    the documentation of a set, as written without --serve
+ *     /file/PROTO_FILE the documentation of one file
+ *     /type/FULL_NAME  the documentation of one message, enum or service
+ *
+ * Runs until killed, and returns a non-zero exit code on failure.
+ */
+int serve(const BatchOptions &options, const protocdoc::ExtractOptions &extractOptions,
+          const Mustache::Template &template_);
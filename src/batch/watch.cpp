@@ -0,0 +1,327 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+#include "watch.h"
+
+#include "../generator.h"
+#include "../protocdoc/model.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <google/protobuf/descriptor.pb.h>
+
+namespace gp = google::protobuf;
+namespace ms = Mustache;
+
+/**
+ * Descriptor database that keeps the files parsed by another database.
+ *
+ * Building a descriptor pool from the kept files needs no parsing, so after a
+ * change only the invalidated files are parsed again.
+ */
+class CachingDatabase : public gp::DescriptorDatabase
+{
+public:
+    explicit CachingDatabase(gp::DescriptorDatabase *database) : m_database(database) {}
+
+    /// Implements google::protobuf::DescriptorDatabase.
+    bool FindFileByName(const std::string &fileName, gp::FileDescriptorProto *output) override
+    {
+        auto it = m_files.find(fileName);
+        if (it != m_files.end()) {
+            output->CopyFrom(it->second);
+            return true;
+        }
+        if (!m_database->FindFileByName(fileName, output)) {
+            return false;
+        }
+        m_files.emplace(fileName, *output);
+        return true;
+    }
+
+    /// Implements google::protobuf::DescriptorDatabase.
+    bool FindFileContainingSymbol(const std::string &, gp::FileDescriptorProto *) override
+    {
+        return false;
+    }
+
+    /// Implements google::protobuf::DescriptorDatabase.
+    bool FindFileContainingExtension(const std::string &, int, gp::FileDescriptorProto *) override
+    {
+        return false;
+    }
+
+    /**
+     * Returns the kept files by name.
+     */
+    const std::map<std::string, gp::FileDescriptorProto> &files() const
+    {
+        return m_files;
+    }
+
+    /**
+     * Drops the files @p fileNames and the files importing them, directly or
+     * indirectly, and adds the names of all dropped files to @p invalidated.
+     */
+    void invalidate(const std::set<std::string> &fileNames, std::set<std::string> *invalidated)
+    {
+        std::multimap<std::string, std::string> importers;
+        for (const auto &file : m_files) {
+            for (const std::string &dependency : file.second.dependency()) {
+                importers.emplace(dependency, file.first);
+            }
+        }
+
+        std::vector<std::string> pending(fileNames.begin(), fileNames.end());
+        while (!pending.empty()) {
+            const std::string fileName = std::move(pending.back());
+            pending.pop_back();
+            if (!invalidated->insert(fileName).second) {
+                continue;
+            }
+            auto range = importers.equal_range(fileName);
+            for (auto it = range.first; it != range.second; ++it) {
+                pending.push_back(it->second);
+            }
+            m_files.erase(fileName);
+        }
+    }
+
+private:
+    gp::DescriptorDatabase *m_database;
+    std::map<std::string, gp::FileDescriptorProto> m_files;
+};
+
+/**
+ * Waits for changes in the directories watched by the inotify instance @p fd.
+ *
+ * Events are collected until none arrive for a short while, so that an editor
+ * saving several files causes one regeneration. The paths of changed files are
+ * added to @p paths, and @p overflow is set if events were lost.
+ *
+ * @return true on success, otherwise false.
+ */
+static bool waitForChanges(int fd, const std::unordered_map<int, std::string> &directories,
+                           std::set<std::string> *paths, bool *overflow)
+{
+    const int quietMilliseconds = 50;
+    alignas(inotify_event) char buffer[65536];
+
+    int timeout = -1;
+    while (true) {
+        pollfd pollFd = { fd, POLLIN, 0 };
+        const int ready = poll(&pollFd, 1, timeout);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        } else if (ready < 0) {
+            return false;
+        } else if (ready == 0) {
+            return true; // Quiet, done collecting.
+        }
+
+        const ssize_t size = read(fd, buffer, sizeof(buffer));
+        if (size < 0 && errno == EINTR) {
+            continue;
+        } else if (size <= 0) {
+            return false;
+        }
+        for (ssize_t pos = 0; pos < size; ) {
+            const inotify_event *event = reinterpret_cast<const inotify_event *>(buffer + pos);
+            pos += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                *overflow = true;
+                continue;
+            }
+            auto it = directories.find(event->wd);
+            if (it != directories.end() && event->len > 0) {
+                paths->insert((std::filesystem::path(it->second) / event->name).string());
+            }
+        }
+        timeout = quietMilliseconds;
+    }
+}
+
+int watch(const BatchOptions &options, const ms::Template &template_)
+{
+    gp::compiler::DiskSourceTree sourceTree;
+    for (const std::string &protoPath : options.protoPaths) {
+        sourceTree.MapPath("", protoPath);
+    }
+    ErrorPrinter errorPrinter;
+    gp::compiler::SourceTreeDescriptorDatabase sourceDatabase(&sourceTree);
+    sourceDatabase.RecordErrorsTo(&errorPrinter);
+    CachingDatabase database(&sourceDatabase);
+
+    // File descriptions are read from the files found through the proto path.
+    protocdoc::ExtractOptions extractOptions;
+    extractOptions.noExclude = options.noExclude;
+    extractOptions.diskFileName = [&sourceTree](const std::string &name) {
+        std::string diskFileName;
+        return sourceTree.VirtualFileToDiskFile(name, &diskFileName) ? diskFileName : name;
+    };
+
+    const int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "inotify_init1: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    std::unordered_map<int, std::string> directories; // Watched directories by watch descriptor.
+    std::set<std::string> watchedDirectories;
+
+    // Extracted files by name, detached so that they outlive the pool.
+    std::unordered_map<std::string, ms::Value> models;
+    std::vector<bool> dirty(options.sets.size(), true);
+
+    while (true) {
+        const auto start = std::chrono::steady_clock::now();
+
+        // Kept files are built into the new pool without being parsed again.
+        gp::DescriptorPool pool(&database, sourceDatabase.GetValidationErrorCollector());
+        pool.EnforceWeakDependencies(true);
+
+        size_t regenerated = 0;
+        size_t failed = 0;
+        for (size_t i = 0; i < options.sets.size(); ++i) {
+            if (!dirty[i]) {
+                continue;
+            }
+
+            const PackageSet &set = options.sets[i];
+            ms::Value files = ms::Value::list_t();
+            std::string error;
+            for (const std::string &protoFileName : set.protoFileNames) {
+                auto it = models.find(protoFileName);
+                if (it == models.end()) {
+                    const gp::FileDescriptor *fileDescriptor = pool.FindFileByName(protoFileName);
+                    if (!fileDescriptor) {
+                        // The parser has printed the errors already.
+                        error = protoFileName + ": Failed to import";
+                        break;
+                    }
+                    ms::Value file = ms::Value::list_t();
+                    protocdoc::addFile(fileDescriptor, extractOptions, &file, &error);
+                    if (!error.empty()) {
+                        break;
+                    }
+                    it = models.emplace(protoFileName, protocdoc::detached(file)).first;
+                }
+                for (const ms::Value &file : it->second.list()) {
+                    files.append(file);
+                }
+            }
+
+            if (error.empty()) {
+                writeDocument(set, options, template_, std::move(files), &error);
+            }
+            if (error.empty()) {
+                dirty[i] = false;
+                ++regenerated;
+            } else {
+                // Keep the set dirty, so that it is retried after the next change.
+                std::cerr << set.outputFileName << ": " << error << std::endl;
+                ++failed;
+            }
+        }
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start);
+        std::cerr << "Regenerated " << regenerated << " of " << options.sets.size() << " outputs";
+        if (failed > 0) {
+            std::cerr << " (" << failed << " failed)";
+        }
+        std::cerr << " in " << elapsed.count() << " ms" << std::endl;
+
+        // Watch the directories of all parsed files and of the files to document,
+        // which may have failed to parse.
+        std::vector<std::string> fileNames;
+        for (const auto &file : database.files()) {
+            fileNames.push_back(file.first);
+        }
+        for (const PackageSet &set : options.sets) {
+            fileNames.insert(fileNames.end(), set.protoFileNames.begin(), set.protoFileNames.end());
+        }
+        for (const std::string &fileName : fileNames) {
+            std::string diskFileName;
+            if (!sourceTree.VirtualFileToDiskFile(fileName, &diskFileName)) {
+                continue;
+            }
+            std::string directory = std::filesystem::path(diskFileName).parent_path().string();
+            if (directory.empty()) {
+                directory = ".";
+            }
+            if (!watchedDirectories.insert(directory).second) {
+                continue;
+            }
+            const int wd = inotify_add_watch(fd, directory.c_str(),
+                                             IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+            if (wd < 0) {
+                std::cerr << directory << ": " << std::strerror(errno) << std::endl;
+                continue;
+            }
+            directories[wd] = directory;
+        }
+
+        // Wait for changes to .proto files, ignoring anything else.
+        std::set<std::string> changed;
+        bool overflow = false;
+        while (changed.empty() && !overflow) {
+            std::set<std::string> paths;
+            if (!waitForChanges(fd, directories, &paths, &overflow)) {
+                std::cerr << "inotify: " << std::strerror(errno) << std::endl;
+                close(fd);
+                return 1;
+            }
+            for (const std::string &path : paths) {
+                std::string virtualFileName;
+                std::string shadowingDiskFileName;
+                if (path.size() > 6 && path.compare(path.size() - 6, 6, ".proto") == 0 &&
+                        sourceTree.DiskFileToVirtualFile(path, &virtualFileName, &shadowingDiskFileName) ==
+                        gp::compiler::DiskSourceTree::SUCCESS) {
+                    changed.insert(virtualFileName);
+                }
+            }
+        }
+
+        // Drop the changed files and their importers, and mark the sets holding
+        // any of them for regeneration. If events were lost, drop everything.
+        if (overflow) {
+            for (const auto &file : database.files()) {
+                changed.insert(file.first);
+            }
+        }
+        std::set<std::string> invalidated;
+        database.invalidate(changed, &invalidated);
+        for (const std::string &fileName : invalidated) {
+            models.erase(fileName);
+        }
+        for (size_t i = 0; i < options.sets.size(); ++i) {
+            for (const std::string &protoFileName : options.sets[i].protoFileNames) {
+                if (invalidated.count(protoFileName)) {
+                    dirty[i] = true;
+                    break;
+                }
+            }
+        }
+    }
+}
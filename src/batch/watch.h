@@ -0,0 +1,29 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+#pragma once
+
+#include "batch.h"
+
+#include "../protocdoc/mustache.h"
+
+/**
+ * Runs the batch driver in watch mode (Linux only).
+ *
+ * Generates all package sets in @p options with @p template_, and then watches
+ * the directories of the parsed .proto files with inotify. When files change,
+ * only they and the files importing them are parsed and extracted again, and
+ * only the outputs of the package sets holding those files are regenerated.
+ * Runs until killed, and returns a non-zero exit code on failure.
+ */
+int watch(const BatchOptions &options, const Mustache::Template &template_);
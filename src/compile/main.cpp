@@ -0,0 +1,92 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+/*
+ * protoc-gen-doc-compile: translates a Mustache template into the C++ source of
+ * a template module, which is built into a shared library and loaded by the
+ * plugin with --doc_out=module=LIBRARY,...
+ */
+
+#include "../protocdoc/markup.h"
+#include "../protocdoc/mustache.h"
+#include "../protocdoc/templateanalyzer.h"
+#include "../protocdoc/templatecompiler.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace ms = Mustache;
+
+/**
+ * Returns a usage help string.
+ */
+static std::string usage()
+{
+    return "Usage: protoc-gen-doc-compile [--collapse-whitespace] TEMPLATE_FILE OUT_FILE\n"
+           "\n"
+           "Translates the Mustache template TEMPLATE_FILE into the C++ source file\n"
+           "OUT_FILE of a template module. Build it into a shared library against the\n"
+           "protocdoc headers, and pass the library to the plugin with\n"
+           "--doc_out=module=LIBRARY,<OUT_FILENAME>:<OUT_DIR>.\n"
+           "\n"
+           "Options:\n"
+           "  --collapse-whitespace  Collapse indentation in the markup of the template.\n";
+}
+
+int main(int argc, char *argv[])
+{
+    bool collapseWhitespace = false;
+    int first = 1;
+    if (argc > 1 && std::string(argv[1]) == "--collapse-whitespace") {
+        collapseWhitespace = true;
+        ++first;
+    }
+    if (argc - first != 2) {
+        std::cerr << usage();
+        return 1;
+    }
+    const std::string templateFileName = argv[first];
+    const std::string outputFileName = argv[first + 1];
+
+    // Read and compile the template.
+    std::ifstream input(templateFileName, std::ios::in | std::ios::binary);
+    std::ostringstream contents;
+    if (!input || !(contents << input.rdbuf())) {
+        std::cerr << templateFileName << ": Failed to read file" << std::endl;
+        return 1;
+    }
+    std::string source = contents.str();
+    if (collapseWhitespace) {
+        source = protocdoc::collapsedWhitespace(source);
+    }
+    ms::Template template_(std::move(source));
+    if (!template_.isValid()) {
+        protocdoc::TextPosition position = protocdoc::textPosition(template_.source(), template_.errorPos());
+        std::cerr << templateFileName << ":" << position.line << ":" << position.column << ": "
+                  << template_.error() << std::endl;
+        return 1;
+    }
+
+    // Write the module source.
+    const std::string code = protocdoc::compiledTemplateModule(template_, templateFileName);
+    std::ofstream output(outputFileName, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!output.write(code.data(), code.size()) || !output.flush()) {
+        std::cerr << outputFileName << ": Failed to write file" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,28 @@
+# Template compiler: translates a Mustache template into the C++ source of a
+# template module. Needs neither Qt nor libprotobuf.
+TEMPLATE = app
+TARGET = protoc-gen-doc-compile
+
+CONFIG += console c++17
+CONFIG -= app_bundle qt
+
+HEADERS += \
+    ../protocdoc/markup.h \
+    ../protocdoc/mustache.h \
+    ../protocdoc/templateanalyzer.h \
+    ../protocdoc/templatecompiler.h \
+    ../protocdoc/templatemodule.h
+
+SOURCES += \
+    ../protocdoc/markup.cpp \
+    ../protocdoc/mustache.cpp \
+    ../protocdoc/templateanalyzer.cpp \
+    ../protocdoc/templatecompiler.cpp \
+    main.cpp
+
+isEmpty(PREFIX):PREFIX = /usr/local
+target.path = $$PREFIX/bin
+INSTALLS += target
+
+# Increase g++ warnings.
+*g++*:QMAKE_CXXFLAGS += -Werror -Wall -Wextra
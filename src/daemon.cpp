@@ -0,0 +1,278 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "daemon.h"
+#include "socketserver.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Wire protocol: the client sends two messages, its working directory and the
+ * serialized request, and the daemon answers with two messages, the serialized
+ * response and the text for the standard error of the client. A message is a
+ * 64-bit length in host byte order followed by that many bytes.
+ */
+
+/// Largest message accepted, protobuf can't parse larger requests anyway.
+static const uint64_t MaxMessageSize = 1u << 30;
+
+/// Seconds a client may stall while sending its request or receiving the response.
+static const int RequestTimeout = 10;
+
+/**
+ * Receives exactly @p size bytes from the socket @p fd into @p data.
+ */
+static bool receiveAll(int fd, char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t received = recv(fd, data, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        } else if (received <= 0) {
+            return false;
+        }
+        data += received;
+        size -= received;
+    }
+    return true;
+}
+
+/**
+ * Sends @p message on the socket @p fd.
+ */
+static bool sendMessage(int fd, const std::string &message)
+{
+    uint64_t size = message.size();
+    return sendAll(fd, reinterpret_cast<const char *>(&size), sizeof(size)) &&
+            sendAll(fd, message.data(), message.size());
+}
+
+/**
+ * Receives a message from the socket @p fd into @p message.
+ *
+ * Fails for messages larger than MaxMessageSize. The message grows as it is
+ * received, so a length that is never sent is never allocated.
+ */
+static bool receiveMessage(int fd, std::string *message)
+{
+    uint64_t size = 0;
+    if (!receiveAll(fd, reinterpret_cast<char *>(&size), sizeof(size)) || size > MaxMessageSize) {
+        return false;
+    }
+    const size_t chunkSize = 1 << 20;
+    message->clear();
+    while (message->size() < size) {
+        const size_t received = message->size();
+        message->resize(received + std::min<uint64_t>(chunkSize, size - received));
+        if (!receiveAll(fd, &(*message)[received], message->size() - received)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Fills in @p address for @p socketPath.
+ *
+ * Returns false if the path is too long for a Unix domain socket address.
+ */
+static bool socketAddress(const std::string &socketPath, sockaddr_un *address)
+{
+    std::memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address->sun_path)) {
+        return false;
+    }
+    std::memcpy(address->sun_path, socketPath.c_str(), socketPath.size() + 1);
+    return true;
+}
+
+/**
+ * Removes the socket of an earlier daemon at @p socketPath, unless that daemon
+ * is still running or the path is not a socket.
+ *
+ * Returns false and prints an error if the path can't be used.
+ */
+static bool removeStaleSocket(const std::string &socketPath, const sockaddr_un &address)
+{
+    struct stat status;
+    if (lstat(socketPath.c_str(), &status) < 0) {
+        if (errno == ENOENT) {
+            return true;
+        }
+        std::cerr << socketPath << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (!S_ISSOCK(status.st_mode)) {
+        std::cerr << socketPath << ": Exists and is not a socket" << std::endl;
+        return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    const bool live = connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+    const int connectError = errno;
+    close(fd);
+    if (live) {
+        std::cerr << socketPath << ": Another daemon is listening on the socket" << std::endl;
+        return false;
+    }
+    if (connectError != ECONNREFUSED) {
+        std::cerr << socketPath << ": " << std::strerror(connectError) << std::endl;
+        return false;
+    }
+    if (unlink(socketPath.c_str()) < 0) {
+        std::cerr << socketPath << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string daemonSocketPath()
+{
+    const char *path = std::getenv("PROTOC_GEN_DOC_SOCKET");
+    return path ? path : std::string();
+}
+
+int runDaemon(const std::string &socketPath, const RequestHandler &handler)
+{
+    sockaddr_un address;
+    if (!socketAddress(socketPath, &address)) {
+        std::cerr << socketPath << ": Socket path too long" << std::endl;
+        return 1;
+    }
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        std::cerr << "socket: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    if (!removeStaleSocket(socketPath, address)) {
+        close(server);
+        return 1;
+    }
+
+    // Whoever can connect can make the daemon load Lua scripts and template
+    // modules, so only let the owner in. No other threads are running yet.
+    const mode_t mask = umask(0177);
+    const bool bound = bind(server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+    const int bindError = errno;
+    umask(mask);
+    if (!bound || listen(server, SOMAXCONN) < 0) {
+        std::cerr << socketPath << ": " << std::strerror(bound ? errno : bindError) << std::endl;
+        close(server);
+        return 1;
+    }
+
+    // At least a few workers, so that a stalled client does not hold up everyone else.
+    const unsigned jobs = std::max(4u, std::thread::hardware_concurrency());
+    serveConnections(server, jobs, RequestTimeout, [&handler](int client) {
+        std::string workingDirectory;
+        std::string request;
+        if (receiveMessage(client, &workingDirectory) && receiveMessage(client, &request)) {
+            std::string diagnostics;
+            const std::string response = handler(request, workingDirectory, &diagnostics);
+            if (sendMessage(client, response)) {
+                sendMessage(client, diagnostics);
+            }
+        }
+    });
+
+    close(server);
+    return 1;
+}
+
+bool forwardToDaemon(const std::string &socketPath, const std::string &request, std::string *response,
+                     std::string *diagnostics)
+{
+    sockaddr_un address;
+    if (!socketAddress(socketPath, &address)) {
+        return false;
+    }
+
+    char *workingDirectory = getcwd(nullptr, 0);
+    if (!workingDirectory) {
+        return false;
+    }
+    const std::string cwd(workingDirectory);
+    std::free(workingDirectory);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+#ifdef SO_NOSIGPIPE
+    int noSigPipe = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+    bool ok = connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0 &&
+            sendMessage(fd, cwd) &&
+            sendMessage(fd, request) &&
+            receiveMessage(fd, response) &&
+            receiveMessage(fd, diagnostics);
+    close(fd);
+
+    return ok;
+}
+
+bool readAll(int fd, std::string *data)
+{
+    char buffer[65536];
+    while (true) {
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        } else if (count < 0) {
+            return false;
+        } else if (count == 0) {
+            return true;
+        }
+        data->append(buffer, count);
+    }
+}
+
+bool writeAll(int fd, const std::string &data)
+{
+    const char *pos = data.data();
+    size_t size = data.size();
+    while (size > 0) {
+        ssize_t written = write(fd, pos, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written <= 0) {
+            return false;
+        }
+        pos += written;
+        size -= written;
+    }
+    return true;
+}
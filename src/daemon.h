@@ -0,0 +1,73 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+/**
+ * Handles one serialized `CodeGeneratorRequest` and returns the serialized
+ * `CodeGeneratorResponse`.
+ *
+ * Relative paths in the request refer to the directory @p workingDirectory.
+ * Messages meant for the standard error of the client, such as reports, are
+ * appended to @p diagnostics. Handlers are called from several threads at once.
+ */
+typedef std::function<std::string(const std::string &request, const std::string &workingDirectory,
+                                  std::string *diagnostics)> RequestHandler;
+
+/**
+ * Returns the socket path of the generation daemon, taken from the
+ * `PROTOC_GEN_DOC_SOCKET` environment variable, or an empty string if unset.
+ */
+std::string daemonSocketPath();
+
+/**
+ * Runs the generation daemon.
+ *
+ * Listens on the Unix domain socket @p socketPath and serves clients in
+ * parallel until killed. Each request is handled with @p handler, given the
+ * working directory of the client; the working directory of the daemon is left
+ * as it is. Returns a non-zero exit code on failure.
+ *
+ * The socket is only accessible to the owner. A socket left behind by an
+ * earlier daemon is replaced, but the daemon refuses to start if another one
+ * is listening on @p socketPath or something else than a socket is there.
+ */
+int runDaemon(const std::string &socketPath, const RequestHandler &handler);
+
+/**
+ * Forwards the serialized @p request to the daemon listening on @p socketPath.
+ *
+ * Returns true and sets @p response to the serialized response and
+ * @p diagnostics to the messages for standard error on success, or returns
+ * false if the daemon could not be reached or the connection failed.
+ */
+bool forwardToDaemon(const std::string &socketPath, const std::string &request, std::string *response,
+                     std::string *diagnostics);
+
+/**
+ * Reads all data from the file descriptor @p fd into @p data.
+ *
+ * Returns true on success, otherwise false.
+ */
+bool readAll(int fd, std::string *data);
+
+/**
+ * Writes all of @p data to the file descriptor @p fd.
+ *
+ * Returns true on success, otherwise false.
+ */
+bool writeAll(int fd, const std::string &data);
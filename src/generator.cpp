@@ -0,0 +1,543 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "generator.h"
+#include "legacy/legacy.h"
+
+#include "protocdoc/filters.h"
+#include "protocdoc/json.h"
+#include "protocdoc/markup.h"
+#include "protocdoc/qtvariantcontext.h"
+#include "protocdoc/templateanalyzer.h"
+#include "protocdoc/templatemodule.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include <QByteArray>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QLibrary>
+
+namespace ms = Mustache;
+
+/**
+ * Return a formatted template rendering error.
+ *
+ * @param name Name of the template in which the error occurred.
+ * @param template_ Template in which the error occurred.
+ * @param renderer Template renderer that failed.
+ * @return Formatted single-line error.
+ */
+static std::string formattedError(const std::string &name, const ms::Template &template_,
+                                  const ms::Renderer &renderer)
+{
+    if (!renderer.errorPartial().empty()) {
+        // The partial source is not at hand, so report the offset into it.
+        return name + " in partial " + renderer.errorPartial() + ":" +
+                std::to_string(renderer.errorPos()) + ": " + renderer.error();
+    }
+    return formattedError(name, template_.source(), renderer.errorPos(), renderer.error());
+}
+
+std::string formattedError(const std::string &name, std::string_view source,
+                           int pos, const std::string &message)
+{
+    protocdoc::TextPosition position = protocdoc::textPosition(source, pos);
+    return name + ":" + std::to_string(position.line) + ":" +
+            std::to_string(position.column) + ": " + message;
+}
+
+QStringList supportedFormats()
+{
+    // The list must match the templates in protoc-gen-doc.qrc. It is kept here
+    // rather than listing the resource directory, which is slow at startup.
+    return QStringList() << "docbook" << "html" << "markdown";
+}
+
+std::string readTemplate(const QString &name, std::string *error)
+{
+    QString fileName = supportedFormats().contains(name) ? QString(":/templates/%1.mustache").arg(name) : name;
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = QString("%1: %2").arg(fileName).arg(file.errorString()).toStdString();
+        return std::string();
+    } else {
+        return file.readAll().toStdString();
+    }
+}
+
+ms::Template compiledTemplate(std::string source)
+{
+    static std::mutex mutex;
+    static std::unordered_map<std::string, ms::Template> templates;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = templates.find(source);
+    if (it == templates.end()) {
+        ms::Template template_(source);
+        it = templates.emplace(std::move(source), std::move(template_)).first;
+    }
+    return it->second;
+}
+
+/**
+ * Loads the template module @p fileName into @p template_.
+ *
+ * Modules are loaded once per process and never unloaded. If an error occurred,
+ * @p error is set to point to an error message and false is returned.
+ */
+static bool loadTemplateModule(const QString &fileName, ms::Template *template_, std::string *error)
+{
+    static std::mutex mutex;
+    static std::unordered_map<std::string, ms::Template> modules;
+
+    // A bare file name would be searched for in the system library paths only.
+    QFileInfo fileInfo(fileName);
+    const QString path = fileInfo.exists() ? fileInfo.absoluteFilePath() : fileName;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = modules.find(path.toStdString());
+    if (it == modules.end()) {
+        typedef const protocdoc::TemplateModule *(*ModuleFunction)();
+
+        QLibrary library(path);
+        auto moduleFunction = reinterpret_cast<ModuleFunction>(library.resolve("protocDocTemplateModule"));
+        if (!moduleFunction) {
+            *error = QString("%1: %2").arg(fileName).arg(library.errorString()).toStdString();
+            return false;
+        }
+        const protocdoc::TemplateModule *module = moduleFunction();
+        if (module->version != protocdoc::TemplateModuleVersion) {
+            *error = fileName.toStdString() + ": Module built for another version of protoc-gen-doc";
+            return false;
+        }
+        ms::Template moduleTemplate(std::string(module->source, module->sourceSize), module->render);
+        it = modules.emplace(path.toStdString(), std::move(moduleTemplate)).first;
+    }
+    *template_ = it->second;
+    return true;
+}
+
+bool loadTemplate(const std::string &name, ms::Template *template_, std::string *error,
+                  bool collapseWhitespace)
+{
+    if (name == "json") {
+        *template_ = ms::Template();
+        return true;
+    }
+
+    // Not "module:", since protoc splits --doc_out at the first ':'.
+    const std::string modulePrefix = "module=";
+    if (name.compare(0, modulePrefix.size(), modulePrefix) == 0) {
+        return loadTemplateModule(QString::fromStdString(name.substr(modulePrefix.size())), template_, error);
+    }
+
+    std::string source = readTemplate(QString::fromStdString(name), error);
+    if (!error->empty()) {
+        return false;
+    }
+    if (collapseWhitespace) {
+        source = protocdoc::collapsedWhitespace(source);
+    }
+    *template_ = compiledTemplate(std::move(source));
+    if (!template_->isValid()) {
+        *error = formattedError(name, template_->source(), template_->errorPos(), template_->error());
+        return false;
+    }
+    return true;
+}
+
+bool templateArguments(ms::Value files, ms::Value *args, std::string *error)
+{
+    // Add filters.
+    protocdoc::addFilters(args);
+
+    // Add files list.
+    (*args)["files"] = std::move(files);
+
+    // Add scalar value types table, which is loaded once per process.
+    static std::mutex mutex;
+    static ms::Value scalarValueTypes;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (scalarValueTypes.isNull()) {
+        QString fileName(":/templates/scalar_value_types.json");
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            *error = QString("%1: %2").arg(fileName).arg(file.errorString()).toStdString();
+            return false;
+        }
+        const QByteArray data = file.readAll();
+        if (!protocdoc::fromJson(std::string_view(data.constData(), data.size()), &scalarValueTypes, error)) {
+            *error = fileName.toStdString() + ": " + *error;
+            return false;
+        }
+    }
+    (*args)["scalar_value_types"] = scalarValueTypes;
+
+    return true;
+}
+
+/**
+ * Adds the entries of the map @p arguments, if any, to the map @p args.
+ */
+static void addArguments(const ms::Value &arguments, ms::Value *args)
+{
+    if (arguments.type() == ms::Value::Map) {
+        for (const auto &argument : arguments.map()) {
+            (*args)[argument.first] = argument.second;
+        }
+    }
+}
+
+bool parseRenderEngine(const std::string &name, RenderEngine *engine)
+{
+    if (name == "value") {
+        *engine = RenderEngine::Value;
+    } else if (name == "variant") {
+        *engine = RenderEngine::Variant;
+    } else if (name == "verify") {
+        *engine = RenderEngine::Verify;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Renders @p template_ with @p context into @p output, adding the time it took
+ * to @p elapsed.
+ *
+ * @return true on success, otherwise false and @p error is set.
+ */
+static bool renderWith(const ms::Template &template_, const std::string &templateName, ms::Context *context,
+                       const ms::RenderLimits &limits, bool memoize, std::string *output, std::string *error,
+                       std::chrono::steady_clock::duration *elapsed)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ms::Renderer renderer;
+    renderer.setLimits(limits);
+    renderer.setMemoization(memoize);
+    *output = renderer.render(template_, context);
+    *elapsed += std::chrono::steady_clock::now() - start;
+
+    if (!renderer.error().empty()) {
+        *error = formattedError(templateName, template_, renderer);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Renders @p template_ with the legacy engine over the list @p files into
+ * @p output, adding the time it took to @p elapsed. The entries of @p arguments
+ * are passed along, except for functions such as Lua filters, which the legacy
+ * engine can't call.
+ *
+ * @return true on success, otherwise false and @p error is set.
+ */
+static bool renderLegacy(const ms::Template &template_, const std::string &templateName, const QVariantList &files,
+                         const ms::Value &arguments, std::string *output, std::string *error,
+                         std::chrono::steady_clock::duration *elapsed)
+{
+    QVariantHash legacyArguments;
+    if (arguments.type() == ms::Value::Map) {
+        for (const auto &argument : arguments.map()) {
+            if (argument.second.type() != ms::Value::Function) {
+                legacyArguments.insert(QString::fromStdString(argument.first), ms::toVariant(argument.second));
+            }
+        }
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const QString source = QString::fromUtf8(template_.source().data(), static_cast<int>(template_.source().size()));
+    QString result;
+    int errorPos = -1;
+    const bool rendered = legacy::render(source, files, legacyArguments, &result, error, &errorPos);
+    *output = result.toStdString();
+    *elapsed += std::chrono::steady_clock::now() - start;
+
+    if (!rendered) {
+        if (errorPos >= 0) {
+            // The legacy renderer counts UTF-16 code units.
+            const int pos = source.left(errorPos).toUtf8().size();
+            *error = formattedError(templateName, template_.source(), pos, *error);
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Returns the start of the last literal text of @p nodes (or nested nodes) found
+ * in @p output before @p end, and sets @p pos to the position of that text in the
+ * template. This locates the part of a template being rendered at @p end.
+ */
+static size_t lastTextBefore(const std::vector<ms::Node> &nodes, const std::string &output, size_t end, int *pos)
+{
+    size_t last = std::string::npos;
+    for (const ms::Node &node : nodes) {
+        size_t found = std::string::npos;
+        int foundPos = -1;
+        // Short texts like a single newline are found anywhere.
+        if (node.type == ms::Node::Text && node.text.size() >= 4 && end >= node.text.size()) {
+            found = output.rfind(node.text.data(), end - node.text.size(), node.text.size());
+            foundPos = node.pos;
+        } else if (!node.children.empty()) {
+            found = lastTextBefore(node.children, output, end, &foundPos);
+        }
+        if (found != std::string::npos && (last == std::string::npos || found > last)) {
+            last = found;
+            *pos = foundPos;
+        }
+    }
+    return last;
+}
+
+/**
+ * Returns a quoted excerpt of @p text around @p pos, on a single line.
+ */
+static std::string excerpt(const std::string &text, size_t pos)
+{
+    const size_t context = 30;
+    const size_t start = pos > context ? pos - context : 0;
+    std::string quoted("\"");
+    for (char ch : text.substr(start, 2 * context)) {
+        if (ch == '\n') {
+            quoted += "\\n";
+        } else if (ch == '"' || ch == '\\') {
+            quoted += '\\';
+            quoted += ch;
+        } else {
+            quoted += ch;
+        }
+    }
+    return quoted + '"';
+}
+
+/**
+ * Returns a message locating the first difference between the output @p expected
+ * of the legacy engine and the output @p actual of the value engine, in the
+ * output, in @p template_ and in the list of files @p files.
+ */
+static std::string differenceMessage(const std::string &templateName, const ms::Template &template_,
+                                     const ms::Value &files, const std::string &expected, const std::string &actual)
+{
+    size_t pos = 0;
+    while (pos < expected.size() && pos < actual.size() && expected[pos] == actual[pos]) {
+        ++pos;
+    }
+    const protocdoc::TextPosition outputPosition = protocdoc::textPosition(expected, static_cast<int>(pos));
+    std::string message = templateName + ": Engines differ at byte " + std::to_string(pos) + " (line " +
+            std::to_string(outputPosition.line) + ", column " + std::to_string(outputPosition.column) +
+            ") of the output";
+
+    // The last template text before the difference, and the last file name.
+    int templatePos = -1;
+    if (lastTextBefore(template_.nodes(), expected, pos, &templatePos) != std::string::npos) {
+        const protocdoc::TextPosition position = protocdoc::textPosition(template_.source(), templatePos);
+        message += ", after template line " + std::to_string(position.line);
+    }
+    size_t filePos = std::string::npos;
+    std::string fileName;
+    for (const ms::Value &file : files.list()) {
+        const ms::Value *name = file.find("file_name");
+        if (name && !name->text().empty()) {
+            const size_t found = expected.rfind(name->text().data(), pos, name->text().size());
+            if (found != std::string::npos && (filePos == std::string::npos || found > filePos)) {
+                filePos = found;
+                fileName = std::string(name->text());
+            }
+        }
+    }
+    if (!fileName.empty()) {
+        message += ", in the documentation of " + fileName;
+    }
+
+    return message + ": legacy engine wrote " + excerpt(expected, pos) + ", value engine wrote " +
+            excerpt(actual, pos);
+}
+
+bool renderDocument(const ms::Template &template_, const std::string &templateName,
+                    bool checkTemplate, ms::Value files, std::string *output, std::string *error,
+                    const ms::Value &arguments, const ms::RenderLimits &limits, bool memoize,
+                    RenderEngine engine, const QVariantList *legacyFiles, std::string *report)
+{
+    if (template_.source().empty()) {
+        // Raw JSON output.
+        *output = protocdoc::toJson(files);
+        return true;
+    }
+
+    ms::Value args;
+    if (!templateArguments(std::move(files), &args, error)) {
+        return false;
+    }
+    addArguments(arguments, &args);
+
+    if (checkTemplate) {
+        // Analyze the template against the model instead of rendering it.
+        protocdoc::TemplateAnalyzer analyzer(template_, args);
+        *output = analyzer.report(templateName);
+        return true;
+    }
+
+    // Render template. The legacy engine renders its own model of the files.
+    std::chrono::steady_clock::duration valueTime(0);
+    std::chrono::steady_clock::duration legacyTime(0);
+    std::string legacyOutput;
+    if (engine != RenderEngine::Value) {
+        if (!legacyFiles) {
+            *error = templateName + ": The legacy engine was not given its model of the files";
+            return false;
+        }
+        if (!renderLegacy(template_, templateName, *legacyFiles, arguments,
+                          engine == RenderEngine::Variant ? output : &legacyOutput, error, &legacyTime)) {
+            return false;
+        }
+        if (engine == RenderEngine::Variant) {
+            return true;
+        }
+    }
+    ms::ValueContext valueContext(args);
+    if (!renderWith(template_, templateName, &valueContext, limits, memoize, output, error, &valueTime)) {
+        return false;
+    }
+
+    if (engine == RenderEngine::Verify) {
+        if (*output != legacyOutput) {
+            *error = differenceMessage(templateName, template_, args["files"], legacyOutput, *output);
+            return false;
+        }
+        if (report) {
+            const double valueMilliseconds = std::chrono::duration<double, std::milli>(valueTime).count();
+            const double legacyMilliseconds = std::chrono::duration<double, std::milli>(legacyTime).count();
+            *report = templateName + ": Engines agree on " + std::to_string(output->size()) + " bytes, value " +
+                    QString::number(valueMilliseconds, 'f', 2).toStdString() + " ms, legacy " +
+                    QString::number(legacyMilliseconds, 'f', 2).toStdString() + " ms (" +
+                    QString::number(legacyMilliseconds / std::max(valueMilliseconds, 0.001), 'f', 1).toStdString() +
+                    "x)";
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Returns the number of nodes in @p nodes, including nested ones, that refer to
+ * the key @p key.
+ */
+static int keyReferences(const std::vector<ms::Node> &nodes, std::string_view key)
+{
+    int count = 0;
+    for (const ms::Node &node : nodes) {
+        if (node.type != ms::Node::Text && node.type != ms::Node::Partial && node.text == key) {
+            ++count;
+        }
+        count += keyReferences(node.children, key);
+    }
+    return count;
+}
+
+bool FileStreamRenderer::canStream(const ms::Template &template_)
+{
+    // Compiled templates are faster rendered as a whole.
+    if (!template_.isValid() || template_.renderFunction() || keyReferences(template_.nodes(), "files") != 1) {
+        return false;
+    }
+    for (const ms::Node &node : template_.nodes()) {
+        if (node.type == ms::Node::Section && node.text == "files") {
+            return true;
+        }
+    }
+    return false;
+}
+
+FileStreamRenderer::FileStreamRenderer(const ms::Template &template_, const std::string &templateName,
+                                       const ms::Value &arguments, const ms::RenderLimits &limits,
+                                       bool memoize)
+    : m_template(template_)
+    , m_templateName(templateName)
+    , m_arguments(arguments)
+    , m_limits(limits)
+    , m_memoize(memoize)
+    , m_written(0)
+    , m_section(nullptr)
+{
+    m_renderer.setLimits(m_limits);
+    m_renderer.setMemoization(m_memoize);
+    for (const ms::Node &node : m_template.nodes()) {
+        if (node.type == ms::Node::Section && node.text == "files") {
+            m_section = &node;
+        } else if (m_section) {
+            m_suffix.push_back(node);
+        } else {
+            m_prefix.push_back(node);
+        }
+    }
+}
+
+bool FileStreamRenderer::begin(std::string *output, std::string *error)
+{
+    m_deadline = std::chrono::steady_clock::now() + m_limits.timeBudget;
+    if (!templateArguments(ms::Value::list_t(), &m_args, error)) {
+        return false;
+    }
+    addArguments(m_arguments, &m_args);
+    m_context.reset(new ms::ValueContext(m_args));
+    return renderNodes(m_prefix, output, error);
+}
+
+bool FileStreamRenderer::addFiles(ms::Value files, std::string *output, std::string *error)
+{
+    // Render the section body for each file, as rendering the whole template would.
+    m_args["files"] = std::move(files);
+    bool ok = true;
+    const int count = m_context->listCount("files");
+    for (int i = 0; i < count && ok; ++i) {
+        m_context->push("files", i);
+        ok = renderNodes(m_section->children, output, error);
+        m_context->pop();
+    }
+
+    // Release the files.
+    m_args["files"] = ms::Value::list_t();
+    return ok;
+}
+
+bool FileStreamRenderer::end(std::string *output, std::string *error)
+{
+    return renderNodes(m_suffix, output, error);
+}
+
+bool FileStreamRenderer::renderNodes(const std::vector<ms::Node> &nodes, std::string *output, std::string *error)
+{
+    // The limits apply to the whole document, so count what was rendered
+    // before, except what is still in output and thus counted by the renderer.
+    const size_t start = output->size();
+    m_renderer.continueDocument(m_written > start ? m_written - start : 0, m_deadline);
+    m_renderer.render(m_template, nodes, m_context.get(), output);
+    m_written += output->size() - start;
+    if (!m_renderer.error().empty()) {
+        *error = formattedError(m_templateName, m_template, m_renderer);
+        return false;
+    }
+    return true;
+}
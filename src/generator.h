@@ -0,0 +1,211 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "protocdoc/mustache.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+
+/**
+ * Returns the list of formats that are supported out of the box.
+ */
+QStringList supportedFormats();
+
+/**
+ * Returns the template specified by @p name.
+ *
+ * The @p name parameter may be either a template file name, or the name of a
+ * supported format ("html", "docbook", ...). If an error occured, @p error is
+ * set to point to an error message and an empty string returned.
+ */
+std::string readTemplate(const QString &name, std::string *error);
+
+/**
+ * Returns the compiled template for @p source.
+ *
+ * Compiled templates are kept for the lifetime of the process, so a process
+ * generating many documents with the same template compiles it only once.
+ * This function is thread-safe.
+ */
+Mustache::Template compiledTemplate(std::string source);
+
+/**
+ * Loads the template specified by @p name into @p template_.
+ *
+ * The name "json" selects raw JSON output, for which @p template_ is set to an
+ * empty template. A name of the form "module=LIBRARY" loads a template module
+ * built from the output of protoc-gen-doc-compile (see protocdoc::TemplateModule),
+ * whose markup is used as is. Otherwise the template is read with readTemplate() and
+ * compiled, after collapsing the whitespace in its markup if
+ * @p collapseWhitespace is true (see protocdoc::collapsedWhitespace()). If an
+ * error occurred, @p error is set to point to an error message and false is
+ * returned.
+ */
+bool loadTemplate(const std::string &name, Mustache::Template *template_, std::string *error,
+                  bool collapseWhitespace = false);
+
+/**
+ * Return a formatted template error.
+ *
+ * @param name Name of the template in which the error occurred.
+ * @param source Source of the template in which the error occurred.
+ * @param pos Position of the error in @p source.
+ * @param message Error message.
+ * @return Formatted single-line error of the form name:line:column: message.
+ */
+std::string formattedError(const std::string &name, std::string_view source,
+                           int pos, const std::string &message);
+
+/**
+ * Builds the arguments passed to templates.
+ *
+ * Moves the list @p files into @p args, along with the template filters and
+ * the scalar value types table. If an error occurred, @p error is set to point
+ * to an error message. This function is thread-safe.
+ *
+ * @param files List of files to render.
+ * @param args Pointer to the map receiving the arguments.
+ * @param error Pointer to error if building the arguments failed.
+ * @return true on success, otherwise false.
+ */
+bool templateArguments(Mustache::Value files, Mustache::Value *args, std::string *error);
+
+/**
+ * Engines for rendering templates.
+ */
+enum class RenderEngine {
+    Value,   ///< Mustache::ValueContext over the model, the default.
+    Variant, ///< The legacy QString renderer over the QVariant model, see legacy::render().
+    Verify   ///< Both, checking that their outputs are identical.
+};
+
+/**
+ * Parses the engine name @p name ("value", "variant" or "verify") into @p engine.
+ *
+ * @return true on success, false if @p name is not the name of an engine.
+ */
+bool parseRenderEngine(const std::string &name, RenderEngine *engine);
+
+/**
+ * Renders the list of files into a document.
+ *
+ * Renders @p files with @p template_, or as raw JSON if the template is empty.
+ * If @p checkTemplate is true, a template analysis is written instead. If an
+ * error occurred, @p error is set to point to an error message. This function
+ * is thread-safe.
+ *
+ * @param template_ Compiled template, or an empty template for JSON output.
+ * @param templateName Name of the template, used in messages.
+ * @param checkTemplate Write a template analysis instead of documentation?
+ * @param files List of files to render.
+ * @param output Pointer to the rendered document.
+ * @param error Pointer to error if rendering failed.
+ * @param arguments Map of additional template arguments, if any.
+ * @param limits Limits on the resources used by rendering.
+ * @param memoize Memoize repeated sections, see Mustache::Renderer::setMemoization().
+ * @param engine Engine rendering the template. RenderEngine::Verify renders with
+ *        both engines and fails with an error locating the first differing byte
+ *        if their outputs differ.
+ * @param legacyFiles The files extracted with legacy::addFile(), which the legacy
+ *        engine renders instead of @p files. Required unless @p engine is
+ *        RenderEngine::Value.
+ * @param report Pointer to a summary of the verification, with the time taken
+ *        by each engine, if @p engine is RenderEngine::Verify.
+ * @return true on success, otherwise false.
+ */
+bool renderDocument(const Mustache::Template &template_, const std::string &templateName,
+                    bool checkTemplate, Mustache::Value files, std::string *output, std::string *error,
+                    const Mustache::Value &arguments = Mustache::Value(),
+                    const Mustache::RenderLimits &limits = Mustache::RenderLimits(), bool memoize = false,
+                    RenderEngine engine = RenderEngine::Value, const QVariantList *legacyFiles = nullptr,
+                    std::string *report = nullptr);
+
+/**
+ * Renders a template of the form PREFIX{{#files}}BODY{{/files}}SUFFIX one file at
+ * a time.
+ *
+ * The prefix is rendered by begin(), the body once for every file passed to
+ * addFiles(), and the suffix by end(). A file can thus be released as soon as it
+ * has been rendered, so memory use is bounded by the largest file rather than by
+ * the whole request. The output is identical to rendering all files at once.
+ */
+class FileStreamRenderer
+{
+public:
+    /**
+     * Returns true if @p template_ can be rendered one file at a time, i.e. if its
+     * only reference to the files list is a single top-level {{#files}} section.
+     */
+    static bool canStream(const Mustache::Template &template_);
+
+    /**
+     * Creates a renderer for @p template_, which must satisfy canStream().
+     * @p templateName is used in error messages. @p arguments is a map of
+     * additional template arguments, if any. @p limits apply to the whole
+     * document: the output of begin(), addFiles() and end() together, and the time
+     * from begin() to the end of end(). Memoization, if @p memoize is true, applies
+     * to each call separately. The output strings passed to the calls must hold
+     * nothing but earlier output of this renderer, if anything.
+     */
+    FileStreamRenderer(const Mustache::Template &template_, const std::string &templateName,
+                       const Mustache::Value &arguments = Mustache::Value(),
+                       const Mustache::RenderLimits &limits = Mustache::RenderLimits(), bool memoize = false);
+    FileStreamRenderer(const FileStreamRenderer &) = delete;
+    FileStreamRenderer &operator=(const FileStreamRenderer &) = delete;
+
+    /**
+     * Renders the part before the {{#files}} section into @p output.
+     *
+     * @return true on success, otherwise false and @p error is set.
+     */
+    bool begin(std::string *output, std::string *error);
+
+    /**
+     * Renders the {{#files}} section for each file in the list @p files into @p output.
+     *
+     * @return true on success, otherwise false and @p error is set.
+     */
+    bool addFiles(Mustache::Value files, std::string *output, std::string *error);
+
+    /**
+     * Renders the part after the {{#files}} section into @p output.
+     *
+     * @return true on success, otherwise false and @p error is set.
+     */
+    bool end(std::string *output, std::string *error);
+
+private:
+    bool renderNodes(const std::vector<Mustache::Node> &nodes, std::string *output, std::string *error);
+
+    Mustache::Template m_template;
+    std::string m_templateName;
+    Mustache::Value m_arguments;
+    Mustache::RenderLimits m_limits;
+    bool m_memoize;
+    Mustache::Renderer m_renderer;   /**< Renderer shared by all calls, counting nodes across them. */
+    size_t m_written;                /**< Bytes of output rendered so far. */
+    std::chrono::steady_clock::time_point m_deadline; /**< End of the time budget, set by begin(). */
+    std::vector<Mustache::Node> m_prefix;
+    const Mustache::Node *m_section;
+    std::vector<Mustache::Node> m_suffix;
+    Mustache::Value m_args;
+    std::unique_ptr<Mustache::ValueContext> m_context;
+};
@@ -0,0 +1,71 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "../protocdoc/model.h"
+
+#include <string>
+
+#include <QString>
+#include <QVariantHash>
+#include <QVariantList>
+
+namespace google {
+namespace protobuf {
+class FileDescriptor;
+}
+}
+
+/**
+ * The legacy engine: the documentation model in QVariants and the QString
+ * Mustache renderer (see LegacyMustache) that protoc-gen-doc used before the
+ * protocdoc library.
+ *
+ * It is kept unchanged so that the output of the protocdoc engine can be
+ * checked against it (see RenderEngine). It knows nothing of features that
+ * came later, such as include/exclude rules, element hashes, render limits and
+ * Lua filters.
+ */
+namespace legacy {
+
+/**
+ * Add file to variant list.
+ *
+ * Adds the file described by @p fileDescriptor to the variant list @p files.
+ * Of @p options, only noExclude and diskFileName are used. If an error occurs,
+ * @p error is set to point to an error message and the function returns
+ * immediately.
+ */
+void addFile(const google::protobuf::FileDescriptor *fileDescriptor, const protocdoc::ExtractOptions &options,
+             QVariantList *files, std::string *error);
+
+/**
+ * Renders the list of files.
+ *
+ * Renders @p files with the template @p template_, along with the p, para and
+ * nobr filters, the scalar value types table and the entries of @p arguments.
+ *
+ * @param template_ Mustache template.
+ * @param files List of files to render.
+ * @param arguments Map of additional template arguments.
+ * @param output Pointer to the rendered document.
+ * @param error Pointer to error if rendering failed.
+ * @param errorPos Pointer to the position in @p template_ of the error, or -1.
+ * @return true on success, otherwise false.
+ */
+bool render(const QString &template_, const QVariantList &files, const QVariantHash &arguments,
+            QString *output, std::string *error, int *errorPos);
+
+} // namespace legacy
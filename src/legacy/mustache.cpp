@@ -19,16 +19,16 @@
 #include <QtCore/QStringList>
 #include <QtCore/QTextStream>
 
-using namespace Mustache;
+using namespace LegacyMustache;
 
-QString Mustache::renderTemplate(const QString& templateString, const QVariantHash& args)
+QString LegacyMustache::renderTemplate(const QString& templateString, const QVariantHash& args)
 {
-	Mustache::QtVariantContext context(args);
-	Mustache::Renderer renderer;
+	LegacyMustache::QtVariantContext context(args);
+	LegacyMustache::Renderer renderer;
 	return renderer.render(templateString, &context);
 }
 
-QString escapeHtml(const QString& input)
+static QString escapeHtml(const QString& input)
 {
 	QString escaped(input);
 	for (int i=0; i < escaped.count();) {
@@ -53,7 +53,7 @@ QString escapeHtml(const QString& input)
 	return escaped;
 }
 
-QString unescapeHtml(const QString& escaped)
+static QString unescapeHtml(const QString& escaped)
 {
 	QString unescaped(escaped);
 	unescaped.replace(QLatin1String("&lt;"), QLatin1String("<"));
@@ -100,7 +100,7 @@ QtVariantContext::QtVariantContext(const QVariant& root, PartialResolver* resolv
 	m_contextStack << root;
 }
 
-QVariant variantMapValue(const QVariant& value, const QString& key)
+static QVariant variantMapValue(const QVariant& value, const QString& key)
 {
 	if (value.userType() == QVariant::Map) {
 		return value.toMap().value(key);
@@ -109,7 +109,7 @@ QVariant variantMapValue(const QVariant& value, const QString& key)
 	}
 }
 
-QVariant variantMapValueForKeyPath(const QVariant& value, const QStringList keyPath)
+static QVariant variantMapValueForKeyPath(const QVariant& value, const QStringList keyPath)
 {
 	if (keyPath.count() > 1) {
 		QVariant firstValue = variantMapValue(value, keyPath.first());
@@ -22,13 +22,13 @@
 #include <functional> /* for std::function */
 #endif
 
-namespace Mustache
+namespace LegacyMustache
 {
 
 class PartialResolver;
 class Renderer;
 
-/** Context is an interface that Mustache::Renderer::render() uses to
+/** Context is an interface that LegacyMustache::Renderer::render() uses to
   * fetch substitutions for template tags.
   */
 class Context
@@ -104,9 +104,9 @@ public:
 	 * or a QVariantMap.
 	 */
 #if __cplusplus >= 201103L
-	typedef std::function<QString(const QString&, Mustache::Renderer*, Mustache::Context*)> fn_t;
+	typedef std::function<QString(const QString&, LegacyMustache::Renderer*, LegacyMustache::Context*)> fn_t;
 #else
-	typedef QString (*fn_t)(const QString&, Mustache::Renderer*, Mustache::Context*);
+	typedef QString (*fn_t)(const QString&, LegacyMustache::Renderer*, LegacyMustache::Context*);
 #endif
 	explicit QtVariantContext(const QVariant& root, PartialResolver* resolver = 0);
 
@@ -116,7 +116,7 @@ public:
 	virtual void push(const QString& key, int index = -1);
 	virtual void pop();
 	virtual bool canEval(const QString& key) const;
-	virtual QString eval(const QString& key, const QString& _template, Mustache::Renderer* renderer);
+	virtual QString eval(const QString& key, const QString& _template, LegacyMustache::Renderer* renderer);
 
 private:
 	QVariant value(const QString& key) const;
@@ -209,7 +209,7 @@ public:
 	Renderer();
 
 	/** Render a Mustache template, using @p context to fetch
-	  * the values used to replace Mustache tags.
+	  * the values used to replace LegacyMustache tags.
 	  */
 	QString render(const QString& _template, Context* context);
 
@@ -273,4 +273,4 @@ QString renderTemplate(const QString& templateString, const QVariantHash& args);
 
 };
 
-Q_DECLARE_METATYPE(Mustache::QtVariantContext::fn_t)
+Q_DECLARE_METATYPE(LegacyMustache::QtVariantContext::fn_t)
@@ -0,0 +1,161 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "luafilters.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#include <lua.hpp>
+
+namespace ms = Mustache;
+
+/**
+ * Lua state shared by the filters of a script.
+ */
+class LuaState {
+public:
+    LuaState()
+        : state(luaL_newstate())
+    {
+        if (state) {
+            // Found by the deadline hook, which only gets the lua_State.
+            *static_cast<LuaState **>(lua_getextraspace(state)) = this;
+        }
+    }
+
+    ~LuaState()
+    {
+        if (state) {
+            lua_close(state);
+        }
+    }
+
+    LuaState(const LuaState &) = delete;
+    LuaState &operator=(const LuaState &) = delete;
+
+    lua_State *state;   /**< The Lua state, or null if out of memory. */
+    std::mutex mutex;   /**< Serializes calls into the state. */
+    std::chrono::steady_clock::time_point deadline; /**< Deadline of the running filter. */
+};
+
+/// Number of Lua instructions between checks of the deadline.
+static const int DeadlineCheckInterval = 10000;
+
+/**
+ * Count hook raising a Lua error in a filter that runs past the deadline of the
+ * render calling it.
+ */
+static void deadlineHook(lua_State *state, lua_Debug *)
+{
+    const LuaState *luaState = *static_cast<LuaState **>(lua_getextraspace(state));
+    if (std::chrono::steady_clock::now() > luaState->deadline) {
+        luaL_error(state, "Rendering took longer than the time budget");
+    }
+}
+
+/**
+ * Returns the message of the error on top of the stack of @p state and pops it.
+ */
+static std::string popError(lua_State *state)
+{
+    const char *message = lua_tostring(state, -1);
+    std::string error(message ? message : "Unknown error");
+    lua_pop(state, 1);
+    return error;
+}
+
+/**
+ * Calls the filter @p name, stored under the registry reference @p function of
+ * @p luaState, on the rendered section body @p text.
+ */
+static std::string callFilter(LuaState *luaState, const std::string &name, int function,
+                              const std::string &text, ms::Renderer *renderer)
+{
+    std::lock_guard<std::mutex> lock(luaState->mutex);
+    lua_State *state = luaState->state;
+
+    // A filter that loops must not hold up the render past its time budget.
+    luaState->deadline = renderer->deadline();
+    const bool hasDeadline = luaState->deadline != std::chrono::steady_clock::time_point::max();
+    if (hasDeadline) {
+        lua_sethook(state, deadlineHook, LUA_MASKCOUNT, DeadlineCheckInterval);
+    }
+
+    lua_rawgeti(state, LUA_REGISTRYINDEX, function);
+    lua_pushlstring(state, text.data(), text.size());
+    const int status = lua_pcall(state, 1, 1, 0);
+    if (hasDeadline) {
+        lua_sethook(state, nullptr, 0, 0);
+    }
+    if (status != LUA_OK) {
+        renderer->setEvalError("Lua filter " + name + ": " + popError(state));
+        return std::string();
+    }
+    if (!lua_isstring(state, -1)) {
+        lua_pop(state, 1);
+        renderer->setEvalError("Lua filter " + name + " must return a string");
+        return std::string();
+    }
+    size_t size = 0;
+    const char *result = lua_tolstring(state, -1, &size);
+    std::string output(result, size);
+    lua_pop(state, 1);
+    return output;
+}
+
+bool loadLuaFilters(const std::string &fileName, ms::Value *filters, std::string *error)
+{
+    std::shared_ptr<LuaState> luaState = std::make_shared<LuaState>();
+    lua_State *state = luaState->state;
+    if (!state) {
+        *error = fileName + ": Failed to create Lua state";
+        return false;
+    }
+    luaL_openlibs(state);
+
+    // Compile and run the script, which returns the table of filters.
+    if (luaL_loadfile(state, fileName.c_str()) != LUA_OK || lua_pcall(state, 0, 1, 0) != LUA_OK) {
+        *error = popError(state);
+        return false;
+    }
+    if (!lua_istable(state, -1)) {
+        *error = fileName + ": Script must return a table of filter functions";
+        return false;
+    }
+
+    // Keep each function in the registry and wrap it in a lambda.
+    lua_pushnil(state);
+    while (lua_next(state, -2) != 0) {
+        if (lua_type(state, -2) != LUA_TSTRING || !lua_isfunction(state, -1)) {
+            *error = fileName + ": Script must return a table of filter functions";
+            return false;
+        }
+        const std::string name = lua_tostring(state, -2);
+        if (name == "files" || name == "scalar_value_types" || name == "search_index") {
+            // Filters may replace the built-in ones, but not the data of the template.
+            *error = fileName + ": Filter name " + name + " is reserved for template data";
+            return false;
+        }
+        const int function = luaL_ref(state, LUA_REGISTRYINDEX);
+        (*filters)[name] = ms::Value::fn_t(
+                    [luaState, name, function](std::string_view text, ms::Renderer *renderer, ms::Context *context) {
+            return callFilter(luaState.get(), name, function, renderer->render(text, context), renderer);
+        });
+    }
+    lua_pop(state, 1);
+
+    return true;
+}
@@ -0,0 +1,40 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "protocdoc/mustache.h"
+
+#include <string>
+
+/**
+ * Loads the template filters defined in the Lua script @p fileName into the map
+ * @p filters.
+ *
+ * The script is compiled once and must return a table mapping filter names to
+ * functions. Each function becomes a lambda like the built-in `p` filter: the
+ * body of a section using the filter is rendered, passed to the function as a
+ * string, and replaced with the string it returns. A Lua error in a filter stops
+ * rendering with an error at the section tag, and so does a filter running past
+ * the time budget of the render (see Mustache::Renderer::deadline()). Filters may
+ * be called from several threads, but calls into Lua are serialized.
+ *
+ * A filter named like a built-in one (p, para or nobr) replaces it. The names
+ * of the template data (files, scalar_value_types and search_index) are
+ * rejected.
+ *
+ * If an error occurred, @p error is set to point to an error message and false
+ * is returned.
+ */
+bool loadLuaFilters(const std::string &fileName, Mustache::Value *filters, std::string *error);
@@ -0,0 +1,128 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "outputwriter.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <google/protobuf/io/zero_copy_stream.h>
+
+AsyncOutputWriter::AsyncOutputWriter(google::protobuf::io::ZeroCopyOutputStream *stream)
+    : m_stream(stream)
+    , m_head(0)
+    , m_tail(0)
+    , m_closing(false)
+    , m_failed(false)
+{
+    for (Chunk &chunk : m_chunks) {
+        chunk.data.reset(new char[ChunkSize]);
+    }
+    m_thread = std::thread(&AsyncOutputWriter::run, this);
+}
+
+AsyncOutputWriter::~AsyncOutputWriter()
+{
+    if (m_thread.joinable()) {
+        close();
+    }
+}
+
+void AsyncOutputWriter::write(std::string_view data)
+{
+    while (!data.empty()) {
+        // The chunk at the head belongs to the producer until it is published,
+        // once the writer thread is done with its previous use.
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        waitFor([&] { return head - m_tail.load(std::memory_order_acquire) < ChunkCount; });
+
+        Chunk &chunk = m_chunks[head % ChunkCount];
+        const size_t size = std::min(data.size(), ChunkSize - chunk.size);
+        std::memcpy(chunk.data.get() + chunk.size, data.data(), size);
+        chunk.size += size;
+        data.remove_prefix(size);
+        if (chunk.size == ChunkSize) {
+            publish();
+        }
+    }
+}
+
+bool AsyncOutputWriter::close()
+{
+    if (m_chunks[m_head.load(std::memory_order_relaxed) % ChunkCount].size > 0) {
+        publish();
+    }
+    m_closing.store(true, std::memory_order_release);
+    notify();
+    m_thread.join();
+    return !m_failed;
+}
+
+void AsyncOutputWriter::publish()
+{
+    m_head.fetch_add(1, std::memory_order_release);
+    notify();
+}
+
+template <typename Predicate>
+void AsyncOutputWriter::waitFor(Predicate predicate)
+{
+    if (predicate()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, predicate);
+}
+
+void AsyncOutputWriter::notify()
+{
+    // Taking the mutex orders this with a waiter checking its predicate, so
+    // the notification can not be lost between the check and the wait.
+    { std::lock_guard<std::mutex> lock(m_mutex); }
+    m_condition.notify_all();
+}
+
+void AsyncOutputWriter::run()
+{
+    size_t tail = 0;
+    for (;;) {
+        waitFor([&] {
+            return tail != m_head.load(std::memory_order_acquire) || m_closing.load(std::memory_order_acquire);
+        });
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            break; // Closing, and all chunks are written.
+        }
+
+        Chunk &chunk = m_chunks[tail % ChunkCount];
+        size_t written = 0;
+        while (written < chunk.size && !m_failed) {
+            void *buffer = nullptr;
+            int size = 0;
+            if (!m_stream->Next(&buffer, &size)) {
+                m_failed = true;
+                break;
+            }
+            const size_t count = std::min(chunk.size - written, static_cast<size_t>(size));
+            std::memcpy(buffer, chunk.data.get() + written, count);
+            written += count;
+            if (count < static_cast<size_t>(size)) {
+                m_stream->BackUp(size - static_cast<int>(count));
+            }
+        }
+        chunk.size = 0;
+
+        m_tail.store(++tail, std::memory_order_release);
+        notify();
+    }
+}
@@ -0,0 +1,84 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+namespace google { namespace protobuf { namespace io { class ZeroCopyOutputStream; } } }
+
+/**
+ * Writes to a ZeroCopyOutputStream on a thread of its own.
+ *
+ * write() copies data into a bounded ring of fixed-size chunks, which a writer
+ * thread drains into the stream, so that rendering the next part of a document
+ * overlaps with writing the previous one. write() only blocks when the ring is
+ * full. There is a single producer: write() and close() must be called from the
+ * same thread.
+ */
+class AsyncOutputWriter
+{
+public:
+    /**
+     * Creates a writer for @p stream, which must outlive it, and starts the
+     * writer thread. Until close() returns, only the writer thread uses @p stream.
+     */
+    explicit AsyncOutputWriter(google::protobuf::io::ZeroCopyOutputStream *stream);
+    AsyncOutputWriter(const AsyncOutputWriter &) = delete;
+    AsyncOutputWriter &operator=(const AsyncOutputWriter &) = delete;
+
+    /// Closes the writer if it has not been closed.
+    ~AsyncOutputWriter();
+
+    /// Queues @p data for writing.
+    void write(std::string_view data);
+
+    /**
+     * Writes the remaining data and stops the writer thread.
+     *
+     * @return true if all data was written to the stream, otherwise false.
+     */
+    bool close();
+
+private:
+    static const size_t ChunkSize = 64 * 1024;
+    static const size_t ChunkCount = 8;
+
+    struct Chunk {
+        std::unique_ptr<char[]> data; /**< ChunkSize bytes. */
+        size_t size = 0;              /**< Number of bytes used. */
+    };
+
+    void publish();
+    template <typename Predicate> void waitFor(Predicate predicate);
+    void notify();
+    void run();
+
+    google::protobuf::io::ZeroCopyOutputStream *m_stream;
+    std::array<Chunk, ChunkCount> m_chunks;
+    std::atomic<size_t> m_head;   /**< Number of chunks published by write(). */
+    std::atomic<size_t> m_tail;   /**< Number of chunks written by the writer thread. */
+    std::atomic<bool> m_closing;  /**< No more chunks will be published? */
+    bool m_failed;                /**< Did writing to the stream fail? Writer thread only. */
+    std::mutex m_mutex;           /**< Only used to sleep while the ring is empty or full. */
+    std::condition_variable m_condition;
+    std::thread m_thread;
+};
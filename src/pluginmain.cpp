@@ -0,0 +1,214 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "pluginmain.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/arena.h>
+#include <google/protobuf/compiler/code_generator.h>
+#include <google/protobuf/compiler/plugin.pb.h>
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+namespace gp = google::protobuf;
+
+namespace {
+
+/**
+ * Writes the fields of a CodeGeneratorResponse to a file descriptor.
+ *
+ * A serialized message may hold its fields in any order, and repeated fields
+ * may be written one element at a time, so the response is written piece by
+ * piece as the files are generated.
+ */
+class ResponseWriter
+{
+public:
+    explicit ResponseWriter(int fileDescriptor)
+        : m_output(fileDescriptor)
+    {
+    }
+
+    /// Writes an element of the `file` field with the given @p name and @p content.
+    void addFile(const std::string &name, const std::string &content)
+    {
+        // CodeGeneratorResponse.file = 15, and File.name = 1, File.content = 15.
+        const size_t size = 1 + gp::io::CodedOutputStream::VarintSize64(name.size()) + name.size() +
+                1 + gp::io::CodedOutputStream::VarintSize64(content.size()) + content.size();
+        gp::io::CodedOutputStream stream(&m_output);
+        stream.WriteTag(fieldTag(15));
+        stream.WriteVarint64(size);
+        stream.WriteTag(fieldTag(1));
+        stream.WriteVarint64(name.size());
+        stream.WriteString(name);
+        stream.WriteTag(fieldTag(15));
+        stream.WriteVarint64(content.size());
+        stream.WriteString(content);
+    }
+
+    /// Writes the `error` field, which makes protoc discard the files.
+    void setError(const std::string &error)
+    {
+        // CodeGeneratorResponse.error = 1.
+        gp::io::CodedOutputStream stream(&m_output);
+        stream.WriteTag(fieldTag(1));
+        stream.WriteVarint64(error.size());
+        stream.WriteString(error);
+    }
+
+    /// Flushes the response, returns true if all of it was written.
+    bool flush()
+    {
+        return m_output.Flush();
+    }
+
+private:
+    /// Returns the tag of the length-delimited field @p number.
+    static uint32_t fieldTag(int number)
+    {
+        return static_cast<uint32_t>(number) << 3 | 2;
+    }
+
+    gp::io::FileOutputStream m_output;
+};
+
+/**
+ * An output file, which is added to the response when closed.
+ */
+class OutputFile : public gp::io::ZeroCopyOutputStream
+{
+public:
+    OutputFile(ResponseWriter *writer, const std::string &name)
+        : m_writer(writer)
+        , m_name(name)
+        , m_stream(&m_content)
+    {
+    }
+
+    ~OutputFile() override
+    {
+        m_writer->addFile(m_name, m_content);
+    }
+
+    /// Implements google::protobuf::io::ZeroCopyOutputStream.
+    bool Next(void **data, int *size) override
+    {
+        return m_stream.Next(data, size);
+    }
+
+    /// Implements google::protobuf::io::ZeroCopyOutputStream.
+    void BackUp(int count) override
+    {
+        m_stream.BackUp(count);
+    }
+
+    /// Implements google::protobuf::io::ZeroCopyOutputStream.
+    int64_t ByteCount() const override
+    {
+        return m_stream.ByteCount();
+    }
+
+private:
+    ResponseWriter *m_writer;
+    std::string m_name;
+    std::string m_content;
+    gp::io::StringOutputStream m_stream;
+};
+
+/**
+ * Generator context writing the output files to a ResponseWriter.
+ */
+class StreamingGeneratorContext : public gp::compiler::GeneratorContext
+{
+public:
+    StreamingGeneratorContext(ResponseWriter *writer, const std::vector<const gp::FileDescriptor *> &parsedFiles)
+        : m_writer(writer)
+        , m_parsedFiles(parsedFiles)
+    {
+    }
+
+    /// Implements google::protobuf::compiler::GeneratorContext.
+    gp::io::ZeroCopyOutputStream *Open(const std::string &fileName) override
+    {
+        return new OutputFile(m_writer, fileName);
+    }
+
+    /// Implements google::protobuf::compiler::GeneratorContext.
+    void ListParsedFiles(std::vector<const gp::FileDescriptor *> *output) override
+    {
+        *output = m_parsedFiles;
+    }
+
+private:
+    ResponseWriter *m_writer;
+    std::vector<const gp::FileDescriptor *> m_parsedFiles;
+};
+
+} // namespace
+
+int streamingPluginMain(const gp::compiler::CodeGenerator *generator, gp::io::ZeroCopyInputStream *input,
+                        int output)
+{
+    // The request, including all descriptors, is freed at once with the arena.
+    gp::Arena arena;
+    gp::compiler::CodeGeneratorRequest *request =
+            gp::Arena::CreateMessage<gp::compiler::CodeGeneratorRequest>(&arena);
+    if (!request->ParseFromZeroCopyStream(input)) {
+        std::cerr << "protoc-gen-doc: protoc sent unparseable request to plugin." << std::endl;
+        return 1;
+    }
+
+    ResponseWriter writer(output);
+    std::string error;
+
+    gp::DescriptorPool pool;
+    for (const gp::FileDescriptorProto &proto : request->proto_file()) {
+        if (!pool.BuildFile(proto)) {
+            error = "Failed to build descriptor for " + proto.name();
+            break;
+        }
+    }
+
+    std::vector<const gp::FileDescriptor *> parsedFiles;
+    for (int i = 0; error.empty() && i < request->file_to_generate_size(); ++i) {
+        const gp::FileDescriptor *file = pool.FindFileByName(request->file_to_generate(i));
+        if (!file) {
+            error = "protoc asked plugin to generate a file but did not provide a descriptor for the file: " +
+                    request->file_to_generate(i);
+        }
+        parsedFiles.push_back(file);
+    }
+
+    if (error.empty()) {
+        StreamingGeneratorContext context(&writer, parsedFiles);
+        if (!generator->GenerateAll(parsedFiles, request->parameter(), &context, &error) && error.empty()) {
+            error = "Code generator returned false but provided no error description.";
+        }
+    }
+    if (!error.empty()) {
+        writer.setError(error);
+    }
+
+    if (!writer.flush()) {
+        std::cerr << "protoc-gen-doc: Failed to write response" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,36 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+namespace google { namespace protobuf {
+namespace io { class ZeroCopyInputStream; }
+namespace compiler { class CodeGenerator; }
+} }
+
+/**
+ * Runs @p generator as a protoc plugin, like google::protobuf::compiler::PluginMain().
+ *
+ * The CodeGeneratorRequest is read from @p input and parsed on an arena, and
+ * the descriptor pool is built from it once. Rather than collecting all output
+ * files in a CodeGeneratorResponse and serializing that at the end, each file is
+ * serialized to the file descriptor @p output as a field of the response as soon
+ * as the generator closes it, and then freed. Only the file being generated is
+ * thus held in memory, and the response never exists twice.
+ *
+ * @return 0 on success, or 1 if the request could not be read or the response
+ * could not be written.
+ */
+int streamingPluginMain(const google::protobuf::compiler::CodeGenerator *generator,
+                        google::protobuf::io::ZeroCopyInputStream *input, int output);
@@ -0,0 +1,107 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "filters.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ms = Mustache;
+
+namespace protocdoc {
+
+std::string paragraphs(std::string_view text, std::string_view open, std::string_view close)
+{
+    std::string result(open);
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t breakPos = text.find_first_of("\r\n", pos);
+        if (breakPos == std::string_view::npos) {
+            break;
+        }
+
+        // Find the last line break in the run of whitespace after breakPos.
+        size_t end = breakPos + 1;
+        size_t lastBreak = std::string_view::npos;
+        while (end < text.size() && std::strchr(" \t\n\v\f\r", text[end])) {
+            if (text[end] == '\n' || text[end] == '\r') {
+                lastBreak = end;
+            }
+            ++end;
+        }
+
+        if (lastBreak == std::string_view::npos) {
+            result.append(text.substr(pos, end - pos));
+        } else {
+            result.append(text.substr(pos, breakPos - pos));
+            result.append(close);
+            result.append(open);
+            end = lastBreak + 1;
+        }
+        pos = end;
+    }
+    if (pos < text.size()) {
+        result.append(text.substr(pos));
+    }
+    result.append(close);
+    return result;
+}
+
+/**
+ * Template filter for breaking paragraphs into HTML `<p>` elements.
+ *
+ * Renders @p text with @p renderer in @p context and returns the result with
+ * paragraphs enclosed in `<p>..</p>`.
+ *
+ */
+static std::string pFilter(std::string_view text, ms::Renderer* renderer, ms::Context* context)
+{
+    return paragraphs(renderer->render(text, context), "<p>", "</p>");
+}
+
+/**
+ * Template filter for breaking paragraphs into DocBook `<para>` elements.
+ *
+ * Renders @p text with @p renderer in @p context and returns the result with
+ * paragraphs enclosed in `<para>..</para>`.
+ *
+ */
+static std::string paraFilter(std::string_view text, ms::Renderer* renderer, ms::Context* context)
+{
+    return paragraphs(renderer->render(text, context), "<para>", "</para>");
+}
+
+/**
+ * Template filter for removing line breaks.
+ *
+ * Renders @p text with @p renderer in @p context and returns the result with
+ * all occurrances of `\r\n`, `\n`, `\r` removed in that order.
+ */
+static std::string nobrFilter(std::string_view text, ms::Renderer* renderer, ms::Context* context)
+{
+    std::string result = renderer->render(text, context);
+    result.erase(std::remove_if(result.begin(), result.end(), [](char ch) {
+        return ch == '\r' || ch == '\n';
+    }), result.end());
+    return result;
+}
+
+void addFilters(ms::Value *args)
+{
+    (*args)["p"] = ms::Value::fn_t(pFilter);
+    (*args)["para"] = ms::Value::fn_t(paraFilter);
+    (*args)["nobr"] = ms::Value::fn_t(nobrFilter);
+}
+
+} // namespace protocdoc
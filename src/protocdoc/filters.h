@@ -0,0 +1,40 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "mustache.h"
+
+#include <string>
+#include <string_view>
+
+namespace protocdoc {
+
+/**
+ * Returns @p text with each paragraph enclosed in @p open and @p close.
+ *
+ * Paragraphs are separated by a line break followed by whitespace and another
+ * line break.
+ */
+std::string paragraphs(std::string_view text, std::string_view open, std::string_view close);
+
+/**
+ * Adds the template filters to the map @p args.
+ *
+ * The filters are the lambdas `p` and `para`, which break paragraphs into HTML
+ * `<p>` and DocBook `<para>` elements, and `nobr`, which removes line breaks.
+ */
+void addFilters(Mustache::Value *args);
+
+} // namespace protocdoc
@@ -0,0 +1,392 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "json.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace ms = Mustache;
+
+namespace protocdoc {
+
+/**
+ * Appends @p text to @p json as a quoted JSON string.
+ */
+static void appendJsonString(std::string_view text, std::string *json)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    json->push_back('"');
+    for (char ch : text) {
+        switch (ch) {
+        case '"': json->append("\\\""); break;
+        case '\\': json->append("\\\\"); break;
+        case '\b': json->append("\\b"); break;
+        case '\f': json->append("\\f"); break;
+        case '\n': json->append("\\n"); break;
+        case '\r': json->append("\\r"); break;
+        case '\t': json->append("\\t"); break;
+        default:
+            if (static_cast<unsigned char>(ch) < 0x20) {
+                json->append("\\u00");
+                json->push_back(hexDigits[ch >> 4]);
+                json->push_back(hexDigits[ch & 0xf]);
+            } else {
+                json->push_back(ch);
+            }
+        }
+    }
+    json->push_back('"');
+}
+
+/**
+ * Appends @p value to @p json as JSON, see toJson().
+ *
+ * @param value Value to append.
+ * @param indent Indentation level of @p value, or -1 for compact JSON.
+ * @param json Pointer to the output string.
+ */
+static void appendJson(const ms::Value &value, int indent, std::string *json)
+{
+    const bool compact = indent < 0;
+    const std::string padding(compact ? 0 : (indent + 1) * 4, ' ');
+    const char *separator = compact ? "," : ",\n";
+    const char *last = compact ? "" : "\n";
+    const int childIndent = compact ? -1 : indent + 1;
+
+    switch (value.type()) {
+    case ms::Value::Bool:
+        json->append(value.toBool() ? "true" : "false");
+        break;
+    case ms::Value::Number:
+        json->append(std::to_string(value.toNumber()));
+        break;
+    case ms::Value::String:
+        appendJsonString(value.text(), json);
+        break;
+    case ms::Value::List:
+        json->push_back('[');
+        json->append(last);
+        for (size_t i = 0; i < value.list().size(); ++i) {
+            json->append(padding);
+            appendJson(value.list()[i], childIndent, json);
+            json->append(i + 1 < value.list().size() ? separator : last);
+        }
+        json->append(compact ? 0 : indent * 4, ' ');
+        json->push_back(']');
+        break;
+    case ms::Value::Map:
+    {
+        std::vector<const std::pair<std::string, ms::Value> *> entries;
+        for (const auto &entry : value.map()) {
+            entries.push_back(&entry);
+        }
+        std::sort(entries.begin(), entries.end(), [](const auto *e1, const auto *e2) {
+            return e1->first < e2->first;
+        });
+
+        json->push_back('{');
+        json->append(last);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            json->append(padding);
+            appendJsonString(entries[i]->first, json);
+            json->append(compact ? ":" : ": ");
+            appendJson(entries[i]->second, childIndent, json);
+            json->append(i + 1 < entries.size() ? separator : last);
+        }
+        json->append(compact ? 0 : indent * 4, ' ');
+        json->push_back('}');
+        break;
+    }
+    default:
+        json->append("null");
+    }
+}
+
+/**
+ * Parser for JSON text, see fromJson().
+ */
+class JsonParser {
+public:
+    explicit JsonParser(std::string_view text) : m_text(text), m_pos(0) {}
+
+    bool parse(ms::Value *value, std::string *error)
+    {
+        if (!parseValue(value) || (skipWhitespace(), m_pos != m_text.size())) {
+            *error = "Invalid JSON at offset " + std::to_string(m_pos);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    void skipWhitespace()
+    {
+        while (m_pos < m_text.size() && std::strchr(" \t\n\r", m_text[m_pos]) && m_text[m_pos]) {
+            ++m_pos;
+        }
+    }
+
+    bool consume(std::string_view token)
+    {
+        if (m_text.substr(m_pos, token.size()) != token) {
+            return false;
+        }
+        m_pos += token.size();
+        return true;
+    }
+
+    bool parseValue(ms::Value *value)
+    {
+        skipWhitespace();
+        if (m_pos == m_text.size()) {
+            return false;
+        }
+        switch (m_text[m_pos]) {
+        case '{':
+            return parseObject(value);
+        case '[':
+            return parseArray(value);
+        case '"':
+        {
+            std::string text;
+            if (!parseString(&text)) {
+                return false;
+            }
+            *value = std::move(text);
+            return true;
+        }
+        case 't':
+            *value = true;
+            return consume("true");
+        case 'f':
+            *value = false;
+            return consume("false");
+        case 'n':
+            *value = ms::Value();
+            return consume("null");
+        default:
+            return parseNumber(value);
+        }
+    }
+
+    bool parseObject(ms::Value *value)
+    {
+        *value = ms::Value::map_t();
+        ++m_pos;
+        skipWhitespace();
+        if (consume("}")) {
+            return true;
+        }
+        do {
+            std::string key;
+            skipWhitespace();
+            if (!parseString(&key)) {
+                return false;
+            }
+            skipWhitespace();
+            if (!consume(":") || !parseValue(&(*value)[key])) {
+                return false;
+            }
+            skipWhitespace();
+        } while (consume(","));
+        return consume("}");
+    }
+
+    bool parseArray(ms::Value *value)
+    {
+        ms::Value::list_t list;
+        ++m_pos;
+        skipWhitespace();
+        if (!consume("]")) {
+            do {
+                list.emplace_back();
+                if (!parseValue(&list.back())) {
+                    return false;
+                }
+                skipWhitespace();
+            } while (consume(","));
+            if (!consume("]")) {
+                return false;
+            }
+        }
+        *value = std::move(list);
+        return true;
+    }
+
+    bool parseHex(unsigned *code)
+    {
+        if (m_pos + 4 > m_text.size()) {
+            return false;
+        }
+        *code = 0;
+        for (int i = 0; i < 4; ++i) {
+            const char ch = m_text[m_pos++];
+            *code <<= 4;
+            if (ch >= '0' && ch <= '9') {
+                *code |= ch - '0';
+            } else if (ch >= 'a' && ch <= 'f') {
+                *code |= ch - 'a' + 10;
+            } else if (ch >= 'A' && ch <= 'F') {
+                *code |= ch - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void appendUtf8(unsigned code, std::string *text)
+    {
+        if (code < 0x80) {
+            text->push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+            text->push_back(static_cast<char>(0xc0 | (code >> 6)));
+            text->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        } else if (code < 0x10000) {
+            text->push_back(static_cast<char>(0xe0 | (code >> 12)));
+            text->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+            text->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        } else {
+            text->push_back(static_cast<char>(0xf0 | (code >> 18)));
+            text->push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+            text->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+            text->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+    }
+
+    bool parseString(std::string *text)
+    {
+        if (!consume("\"")) {
+            return false;
+        }
+        while (m_pos < m_text.size()) {
+            const char ch = m_text[m_pos++];
+            if (ch == '"') {
+                return true;
+            } else if (ch != '\\') {
+                text->push_back(ch);
+                continue;
+            } else if (m_pos == m_text.size()) {
+                return false;
+            }
+            switch (m_text[m_pos++]) {
+            case '"': text->push_back('"'); break;
+            case '\\': text->push_back('\\'); break;
+            case '/': text->push_back('/'); break;
+            case 'b': text->push_back('\b'); break;
+            case 'f': text->push_back('\f'); break;
+            case 'n': text->push_back('\n'); break;
+            case 'r': text->push_back('\r'); break;
+            case 't': text->push_back('\t'); break;
+            case 'u':
+            {
+                unsigned code;
+                if (!parseHex(&code)) {
+                    return false;
+                }
+                if (code >= 0xd800 && code < 0xdc00) {
+                    // High surrogate, which must be followed by a low one.
+                    unsigned low;
+                    if (!consume("\\u") || !parseHex(&low) || low < 0xdc00 || low >= 0xe000) {
+                        return false;
+                    }
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                }
+                appendUtf8(code, text);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Skips the digits at the current position and returns their number.
+     */
+    size_t skipDigits()
+    {
+        const size_t start = m_pos;
+        while (m_pos < m_text.size() && m_text[m_pos] >= '0' && m_text[m_pos] <= '9') {
+            ++m_pos;
+        }
+        return m_pos - start;
+    }
+
+    bool parseNumber(ms::Value *value)
+    {
+        // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+        const size_t start = m_pos;
+        consume("-");
+        if (!consume("0") && skipDigits() == 0) {
+            return false;
+        }
+        bool integer = true;
+        if (consume(".")) {
+            integer = false;
+            if (skipDigits() == 0) {
+                return false;
+            }
+        }
+        if (consume("e") || consume("E")) {
+            integer = false;
+            if (!consume("+")) {
+                consume("-");
+            }
+            if (skipDigits() == 0) {
+                return false;
+            }
+        }
+        const std::string_view number = m_text.substr(start, m_pos - start);
+
+        // The model has no floating point values, so those are kept as text, and
+        // so are integers too large for it.
+        long long result = 0;
+        const char *end = number.data() + number.size();
+        if (integer && std::from_chars(number.data(), end, result).ec == std::errc()) {
+            *value = result;
+        } else {
+            *value = std::string(number);
+        }
+        return true;
+    }
+
+    std::string_view m_text;
+    size_t m_pos;
+};
+
+std::string toJson(const ms::Value &value, JsonFormat format)
+{
+    std::string json;
+    if (format == Compact) {
+        appendJson(value, -1, &json);
+    } else {
+        appendJson(value, 0, &json);
+        json.push_back('\n');
+    }
+    return json;
+}
+
+bool fromJson(std::string_view text, ms::Value *value, std::string *error)
+{
+    return JsonParser(text).parse(value, error);
+}
+
+} // namespace protocdoc
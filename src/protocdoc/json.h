@@ -0,0 +1,49 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "mustache.h"
+
+#include <string>
+#include <string_view>
+
+namespace protocdoc {
+
+/**
+ * Formats of JSON text written by toJson().
+ */
+enum JsonFormat {
+    Indented,   /**< Four spaces of indentation per level, followed by a line break. */
+    Compact     /**< No whitespace at all. */
+};
+
+/**
+ * Returns @p value as JSON text in the format @p format.
+ *
+ * The output is the same as that of QJsonDocument::toJson(), with object keys
+ * sorted. Function values are written as null.
+ */
+std::string toJson(const Mustache::Value &value, JsonFormat format = Indented);
+
+/**
+ * Parses the JSON text @p text into @p value.
+ *
+ * Integers become numbers and other numbers are kept as strings, since values
+ * have no floating point type. If the text is not valid JSON, @p error is set
+ * to point to an error message and false is returned.
+ */
+bool fromJson(std::string_view text, Mustache::Value *value, std::string *error);
+
+} // namespace protocdoc
@@ -0,0 +1,176 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "manifest.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace ms = Mustache;
+
+namespace protocdoc {
+
+/// Round constants of SHA-256.
+static const uint32_t sha256Constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t rotateRight(uint32_t value, int bits)
+{
+    return value >> bits | value << (32 - bits);
+}
+
+/**
+ * Updates the SHA-256 state @p state with the 64-byte block @p block.
+ */
+static void sha256Block(uint32_t state[8], const unsigned char *block)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = uint32_t(block[4 * i]) << 24 | uint32_t(block[4 * i + 1]) << 16 |
+               uint32_t(block[4 * i + 2]) << 8 | uint32_t(block[4 * i + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+        const uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ w[i - 15] >> 3;
+        const uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ w[i - 2] >> 10;
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+        const uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+        const uint32_t t1 = h + s1 + ((e & f) ^ (~e & g)) + sha256Constants[i] + w[i];
+        const uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+        const uint32_t t2 = s0 + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+std::string contentHash(std::string_view data)
+{
+    uint32_t state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data.data());
+    size_t size = data.size();
+    for (; size >= 64; size -= 64, bytes += 64) {
+        sha256Block(state, bytes);
+    }
+
+    // Pad the rest with a one bit, zeros and the length in bits.
+    unsigned char last[128] = {};
+    std::memcpy(last, bytes, size);
+    last[size] = 0x80;
+    const size_t lastSize = size < 56 ? 64 : 128;
+    const uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+    for (int i = 0; i < 8; ++i) {
+        last[lastSize - 1 - i] = static_cast<unsigned char>(bits >> (8 * i));
+    }
+    for (size_t offset = 0; offset < lastSize; offset += 64) {
+        sha256Block(state, last + offset);
+    }
+
+    char buffer[65];
+    for (int i = 0; i < 8; ++i) {
+        std::snprintf(buffer + 8 * i, 9, "%08x", static_cast<unsigned>(state[i]));
+    }
+    return buffer;
+}
+
+/**
+ * Appends an entry for each element in the list @p elements of kind @p kind,
+ * declared in the file @p fileName, to @p entries. @p elements may be null.
+ */
+static void addElements(const ms::Value *elements, const char *kind, std::string_view fileName,
+                        ms::Value::list_t *entries)
+{
+    if (!elements) {
+        return;
+    }
+    const std::string prefix(kind);
+    for (const ms::Value &element : elements->list()) {
+        const ms::Value *hash = element.find(prefix + "_hash");
+        const ms::Value *name = element.find(prefix + "_full_name");
+        if (!hash || !name) {
+            continue;
+        }
+        ms::Value entry;
+        entry["kind"] = kind;
+        entry["name"] = std::string(name->text());
+        entry["file"] = std::string(fileName);
+        entry["hash"] = std::string(hash->text());
+        entries->push_back(std::move(entry));
+    }
+}
+
+ms::Value manifest(const ms::Value &files)
+{
+    ms::Value::list_t elements;
+    for (const ms::Value &file : files.list()) {
+        const ms::Value *hash = file.find("file_hash");
+        const ms::Value *name = file.find("file_path");
+        if (!hash || !name) {
+            continue;
+        }
+        const std::string_view fileName = name->text();
+        ms::Value entry;
+        entry["kind"] = "file";
+        entry["name"] = std::string(fileName);
+        entry["hash"] = std::string(hash->text());
+        elements.push_back(std::move(entry));
+
+        addElements(file.find("file_messages"), "message", fileName, &elements);
+        addElements(file.find("file_enums"), "enum", fileName, &elements);
+        addElements(file.find("file_services"), "service", fileName, &elements);
+    }
+
+    ms::Value result;
+    result["outputs"] = ms::Value::list_t();
+    result["elements"] = std::move(elements);
+    return result;
+}
+
+void addManifestOutput(const std::string &name, std::string_view contents, ms::Value *manifest)
+{
+    ms::Value entry;
+    entry["name"] = name;
+    entry["hash"] = contentHash(contents);
+    (*manifest)["outputs"].append(std::move(entry));
+}
+
+} // namespace protocdoc
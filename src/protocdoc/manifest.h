@@ -0,0 +1,53 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "mustache.h"
+
+#include <string>
+#include <string_view>
+
+namespace protocdoc {
+
+/**
+ * Returns a hash of @p data as a hexadecimal string.
+ *
+ * The hash is SHA-256, since manifests drive long-lived caches, where two versions
+ * of a file or an element with the same hash would be served stale indefinitely.
+ */
+std::string contentHash(std::string_view data);
+
+/**
+ * Returns a manifest of the elements in the list of extracted files @p files.
+ *
+ * @p files should be extracted with ExtractOptions::elementHashes set, elements
+ * without a hash are left out. Output files are added to the manifest with
+ * addManifestOutput(). The manifest is a map of the form
+ *
+ *     {"outputs": [{"name": NAME, "hash": HASH}, ...],
+ *      "elements": [{"kind": KIND, "name": NAME, "file": FILE, "hash": HASH}, ...]}
+ *
+ * where KIND is "file", "message", "enum" or "service", NAME is the name of the
+ * output file, the path of the file as imported or the full name of the element,
+ * and FILE is the path of the file holding the element (absent for files).
+ */
+Mustache::Value manifest(const Mustache::Value &files);
+
+/**
+ * Adds the output file @p name with the contents @p contents to @p manifest.
+ */
+void addManifestOutput(const std::string &name, std::string_view contents, Mustache::Value *manifest);
+
+} // namespace protocdoc
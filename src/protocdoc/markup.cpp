@@ -0,0 +1,150 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "markup.h"
+
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+namespace protocdoc {
+
+/**
+ * Returns true if @p text starts with @p prefix, ignoring case.
+ */
+static bool startsWithIgnoringCase(std::string_view text, std::string_view prefix)
+{
+    if (text.size() < prefix.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < prefix.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(text[i])) != prefix[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Returns the length of the name of the preformatted element opened or closed
+ * by the markup tag at the start of @p text, or 0 if it is no such tag.
+ */
+static size_t preformattedElement(std::string_view text, bool closing)
+{
+    static const char *elements[] = {
+        "pre", "textarea", "programlisting", "screen", "literallayout", "synopsis"
+    };
+
+    text.remove_prefix(closing ? 2 : 1);
+    for (const char *element : elements) {
+        const size_t length = std::strlen(element);
+        if (startsWithIgnoringCase(text, element) &&
+                (text.size() == length || !std::isalnum(static_cast<unsigned char>(text[length])))) {
+            return length;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Collapser of whitespace in static template text, see collapsedWhitespace().
+ *
+ * The state carries over between the pieces of text separated by Mustache tags.
+ */
+class WhitespaceCollapser {
+public:
+    void append(std::string_view text, std::string *output)
+    {
+        for (size_t pos = 0; pos < text.size(); ) {
+            const char ch = text[pos];
+
+            if (m_preformatted.empty() && !m_quote && std::isspace(static_cast<unsigned char>(ch))) {
+                size_t end = pos;
+                bool lineBreak = false;
+                while (end < text.size() && std::isspace(static_cast<unsigned char>(text[end]))) {
+                    lineBreak = lineBreak || text[end] == '\n';
+                    ++end;
+                }
+                if (lineBreak) {
+                    output->push_back('\n');
+                } else {
+                    output->append(text.substr(pos, end - pos));
+                }
+                pos = end;
+                continue;
+            }
+
+            if (m_inTag) {
+                if (m_quote && ch == m_quote) {
+                    m_quote = 0;
+                } else if (!m_quote && (ch == '"' || ch == '\'')) {
+                    m_quote = ch;
+                } else if (!m_quote && ch == '>') {
+                    m_inTag = false;
+                }
+            } else if (ch == '<' && pos + 1 < text.size() &&
+                       (std::isalpha(static_cast<unsigned char>(text[pos + 1])) || text[pos + 1] == '/' ||
+                        text[pos + 1] == '!' || text[pos + 1] == '?')) {
+                m_inTag = true;
+                const bool closing = text[pos + 1] == '/';
+                const size_t length = preformattedElement(text.substr(pos), closing);
+                if (length > 0) {
+                    const std::string element(text.substr(pos + (closing ? 2 : 1), length));
+                    if (!closing) {
+                        m_preformatted.push_back(element);
+                    } else if (!m_preformatted.empty()) {
+                        m_preformatted.pop_back();
+                    }
+                }
+            }
+            output->push_back(ch);
+            ++pos;
+        }
+    }
+
+private:
+    bool m_inTag = false;
+    char m_quote = 0;
+    std::vector<std::string> m_preformatted;
+};
+
+std::string collapsedWhitespace(std::string_view source)
+{
+    if (source.find("{{=") != std::string_view::npos) {
+        return std::string(source);
+    }
+
+    std::string output;
+    output.reserve(source.size());
+    WhitespaceCollapser collapser;
+
+    size_t pos = 0;
+    while (pos < source.size()) {
+        // Collapse the text up to the next tag, and copy the tag as it is.
+        const size_t tagStart = source.find("{{", pos);
+        collapser.append(source.substr(pos, tagStart - pos), &output);
+        if (tagStart == std::string_view::npos) {
+            break;
+        }
+        const bool triple = source.compare(tagStart, 3, "{{{") == 0;
+        size_t tagEnd = source.find(triple ? "}}}" : "}}", tagStart + 2);
+        tagEnd = tagEnd == std::string_view::npos ? source.size() : tagEnd + (triple ? 3 : 2);
+        output.append(source.substr(tagStart, tagEnd - tagStart));
+        pos = tagEnd;
+    }
+
+    return output;
+}
+
+} // namespace protocdoc
@@ -0,0 +1,36 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace protocdoc {
+
+/**
+ * Returns the Mustache template source @p source with insignificant whitespace
+ * in its static markup text collapsed.
+ *
+ * Every run of whitespace holding a line break, such as the indentation of HTML
+ * or DocBook markup, is replaced by a single line break, which is equivalent in
+ * markup outside of preformatted elements. Mustache tags, quoted attribute values
+ * and the contents of preformatted elements (pre, textarea, programlisting,
+ * screen, literallayout and synopsis) are left as they are, and so are values
+ * substituted when rendering. Templates which change the tag delimiters are
+ * returned unchanged.
+ */
+std::string collapsedWhitespace(std::string_view source);
+
+} // namespace protocdoc
@@ -0,0 +1,830 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "model.h"
+
+#include "json.h"
+#include "manifest.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <istream>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/descriptor.pb.h>
+
+namespace gp = google::protobuf;
+namespace ms = Mustache;
+
+namespace protocdoc {
+
+/**
+ * Adds a hash of the contents of @p element to it under @p key, if enabled in
+ * @p options.
+ */
+static void addHash(const char *key, const ExtractOptions &options, ms::Value *element)
+{
+    if (options.elementHashes) {
+        std::string hash = contentHash(toJson(*element, Compact));
+        (*element)[key] = std::move(hash);
+    }
+}
+
+/**
+ * Returns @p text with leading and trailing whitespace removed.
+ */
+static std::string_view trimmed(std::string_view text)
+{
+    const char *whitespace = " \t\n\v\f\r";
+    size_t start = text.find_first_not_of(whitespace);
+    if (start == std::string_view::npos) {
+        return std::string_view();
+    }
+    size_t end = text.find_last_not_of(whitespace);
+    return text.substr(start, end - start + 1);
+}
+
+/**
+ * Returns true if @p text starts with @p prefix.
+ */
+static bool startsWith(std::string_view text, std::string_view prefix)
+{
+    return text.substr(0, prefix.size()) == prefix;
+}
+
+/**
+ * Returns the "long" name of the message, enum, field or extension described by
+ * @p descriptor.
+ *
+ * The long name is the name of the message, field, enum or extension, preceeded
+ * by the names of its enclosing types, separated by dots. E.g. for "Baz" it could
+ * be "Foo.Bar.Baz".
+ */
+template<typename T>
+static std::string longName(const T *descriptor)
+{
+    if (!descriptor) {
+        return std::string();
+    } else if (!descriptor->containing_type()) {
+        return descriptor->name();
+    }
+    return longName(descriptor->containing_type()) + "." + descriptor->name();
+}
+
+// Specialization for T = FieldDescriptor, since we want to follow extension_scope()
+// if it's an extension, not containing_type().
+template<>
+std::string longName(const gp::FieldDescriptor *fieldDescriptor) {
+    if (fieldDescriptor->is_extension()) {
+        return longName(fieldDescriptor->extension_scope()) + "." + fieldDescriptor->name();
+    } else {
+        return longName(fieldDescriptor->containing_type()) + "." + fieldDescriptor->name();
+    }
+}
+
+/**
+ * Returns the text of the string value for @p key in the map value @p value,
+ * or an empty string if there is no such value.
+ */
+static std::string_view textOf(const ms::Value &value, std::string_view key)
+{
+    const ms::Value *item = value.find(key);
+    return item ? item->text() : std::string_view();
+}
+
+/**
+ * Returns true if the value @p v1 is less than @p v2.
+ *
+ * It is assumed that both values are maps with either a "message_long_name",
+ * a "message_long_name" or a "extension_long_name" key. This comparator is used
+ * when sorting the message, enum and extension lists for a file.
+ */
+static inline bool longNameLessThan(const ms::Value &v1, const ms::Value &v2)
+{
+    if (textOf(v1, "message_long_name") < textOf(v2, "message_long_name"))
+        return true;
+    if (textOf(v1, "enum_long_name") < textOf(v2, "enum_long_name"))
+        return true;
+    return textOf(v1, "extension_long_name") < textOf(v2, "extension_long_name");
+}
+
+/**
+ * Appends the documentation comment @p comment to @p description.
+ *
+ * Only comments starting with an extra '*' or '/' are documentation comments.
+ * The marker is dropped and a single space is removed from the start of each
+ * line.
+ */
+static void appendDocComment(const std::string &comment, std::string *description)
+{
+    if (comment.empty() || (comment[0] != '*' && comment[0] != '/')) {
+        return;
+    }
+    bool lineStart = true;
+    for (size_t i = 1; i < comment.size(); ++i) {
+        const char ch = comment[i];
+        if (!(lineStart && ch == ' ')) {
+            *description += ch;
+        }
+        lineStart = ch == '\n';
+    }
+}
+
+/**
+ * Strips a leading @exclude directive from @p description.
+ *
+ * If the description starts with @exclude, the directive is removed and
+ * @p excluded is set to true, unless @exclude directives are ignored.
+ * Otherwise @p excluded is set to false.
+ */
+static std::string excludeDirective(std::string_view description, const ExtractOptions &options, bool &excluded)
+{
+    excluded = false;
+    if (startsWith(description, "@exclude")) {
+        description.remove_prefix(8);
+        excluded = !options.noExclude;
+    }
+    return std::string(description);
+}
+
+/**
+ * Returns the description of the item described by @p descriptor.
+ *
+ * The item can be a message, enum, enum value, extension, field, service or
+ * service method.
+ *
+ * The description is taken as the leading comments followed by the trailing
+ * comments. If present, a single space is removed from the start of each line.
+ * Whitespace is trimmed from the final result before it is returned.
+ * 
+ * If the described item should be excluded from the generated documentation,
+ * @p exclude is set to true. Otherwise it is set to false.
+ */
+template<typename T>
+static std::string descriptionOf(const T *descriptor, const ExtractOptions &options, bool &excluded)
+{
+    std::string description;
+
+    gp::SourceLocation sourceLocation;
+    descriptor->GetSourceLocation(&sourceLocation);
+
+    // Check for leading and trailing documentation comments.
+    appendDocComment(sourceLocation.leading_comments, &description);
+    appendDocComment(sourceLocation.trailing_comments, &description);
+
+    // Check if item should be excluded.
+    return excludeDirective(trimmed(description), options, excluded);
+}
+
+/**
+ * Reads the next line from @p stream into @p line, with whitespace trimmed.
+ * Returns an empty line at the end of the stream.
+ */
+static std::string_view readLine(std::istream &stream, std::string *line)
+{
+    if (!std::getline(stream, *line)) {
+        line->clear();
+    }
+    return trimmed(*line);
+}
+
+/**
+ * Returns the description of the file described by @p fileDescriptor.
+ *
+ * If the first non-whitespace characters in the file is a block of consecutive
+ * single-line (///) documentation comments, or a multi-line documentation comment,
+ * the contents of that block of comments or comment is taken as the description of
+ * the file. If a line inside a multi-line comment starts with "* ", " *" or " * "
+ * then that prefix is stripped from the line before it is added to the description.
+ *
+ * With ExtractOptions::descriptionFromSourceInfo, the first comment attached to the
+ * first statement of the file in its source info is used instead, so the file is
+ * not read.
+ *
+ * If the file has no description, an empty string is returned. If an error occurs,
+ * @p error is set to point to an error message and an empty string is returned.
+ * 
+ * If the described file should be excluded from the generated documentation,
+ * @p exclude is set to true. Otherwise it is set to false.
+ */
+static std::string descriptionOf(const gp::FileDescriptor *fileDescriptor, const ExtractOptions &options,
+                                 std::string *error, bool &excluded)
+{
+    if (options.descriptionFromSourceInfo) {
+        // The first comment of the file is attached to its first statement.
+        gp::FileDescriptorProto proto;
+        fileDescriptor->CopySourceCodeInfoTo(&proto);
+        const gp::SourceCodeInfo::Location *first = nullptr;
+        for (const gp::SourceCodeInfo::Location &location : proto.source_code_info().location()) {
+            if (location.path_size() == 0 || location.span_size() < 2) {
+                continue;
+            }
+            const bool hasComments = location.has_leading_comments() || location.leading_detached_comments_size() > 0;
+            if (!first || location.span(0) < first->span(0) ||
+                    (location.span(0) == first->span(0) && location.span(1) < first->span(1)) ||
+                    (location.span(0) == first->span(0) && location.span(1) == first->span(1) && hasComments)) {
+                first = &location;
+            }
+        }
+
+        std::string comment;
+        if (first && first->leading_detached_comments_size() > 0) {
+            comment = first->leading_detached_comments(0);
+        } else if (first) {
+            comment = first->leading_comments();
+        }
+
+        // Every line of a block of /// comments starts with the extra '/'.
+        if (startsWith(comment, "/")) {
+            for (size_t pos = comment.find("\n/"); pos != std::string::npos; pos = comment.find("\n/", pos + 1)) {
+                comment.erase(pos + 1, 1);
+            }
+        }
+
+        std::string description;
+        appendDocComment(comment, &description);
+        return excludeDirective(trimmed(description), options, excluded);
+    }
+
+    // Since there's no API in gp::FileDescriptor for getting the "file
+    // level" comment, we open the file and extract this out ourselves.
+
+    // Open file.
+    const std::string fileName = options.diskFileName ?
+            options.diskFileName(fileDescriptor->name()) : fileDescriptor->name();
+    std::ifstream stream(fileName, std::ios::in | std::ios::binary);
+    if (!stream) {
+        *error = fileName + ": " + std::strerror(errno);
+        excluded = false;
+        return std::string();
+    }
+
+    // Extract the description.
+    std::string buffer;
+    std::string description;
+    while (stream.peek() != std::ifstream::traits_type::eof()) {
+        std::string_view line = readLine(stream, &buffer);
+        if (line.empty()) {
+            continue;
+        } else if (startsWith(line, "///")) {
+            while (stream.peek() != std::ifstream::traits_type::eof() && startsWith(line, "///")) {
+                description += line.substr(startsWith(line, "/// ") ? 4 : 3);
+                description += '\n';
+                line = readLine(stream, &buffer);
+            }
+            if (!description.empty()) {
+                description.pop_back();
+            }
+        } else if (startsWith(line, "/**") && !startsWith(line, "/***/")) {
+            line.remove_prefix(2);
+            size_t start, end;
+            while ((end = line.find("*/")) == std::string_view::npos && stream) {
+                start = 0;
+                if (startsWith(line, "*")) ++start;
+                if (startsWith(line, "* ")) ++start;
+                description += line.substr(start);
+                description += '\n';
+                line = readLine(stream, &buffer);
+            }
+            start = 0;
+            if (startsWith(line, "*") && !startsWith(line, "*/")) ++start;
+            if (startsWith(line, "* ")) ++start;
+            if (end != std::string_view::npos && end > start) {
+                description += line.substr(start, end - start);
+            }
+        }
+        break;
+    }
+
+    // Check if the file should be excluded.
+    return excludeDirective(trimmed(description), options, excluded);
+}
+
+/**
+ * Returns the name of the scalar field type @p type.
+ */
+static std::string_view scalarTypeName(gp::FieldDescriptor::Type type)
+{
+    switch (type) {
+        case gp::FieldDescriptor::TYPE_BOOL:
+            return "bool";
+        case gp::FieldDescriptor::TYPE_BYTES:
+            return "bytes";
+        case gp::FieldDescriptor::TYPE_DOUBLE:
+            return "double";
+        case gp::FieldDescriptor::TYPE_FIXED32:
+            return "fixed32";
+        case gp::FieldDescriptor::TYPE_FIXED64:
+            return "fixed64";
+        case gp::FieldDescriptor::TYPE_FLOAT:
+            return "float";
+        case gp::FieldDescriptor::TYPE_INT32:
+            return "int32";
+        case gp::FieldDescriptor::TYPE_INT64:
+            return "int64";
+        case gp::FieldDescriptor::TYPE_SFIXED32:
+            return "sfixed32";
+        case gp::FieldDescriptor::TYPE_SFIXED64:
+            return "sfixed64";
+        case gp::FieldDescriptor::TYPE_SINT32:
+            return "sint32";
+        case gp::FieldDescriptor::TYPE_SINT64:
+            return "sint64";
+        case gp::FieldDescriptor::TYPE_STRING:
+            return "string";
+        case gp::FieldDescriptor::TYPE_UINT32:
+            return "uint32";
+        case gp::FieldDescriptor::TYPE_UINT64:
+            return "uint64";
+        default:
+            return "<unknown>";
+    }
+}
+
+/**
+ * Returns the name of the field label @p label.
+ */
+static std::string_view labelName(gp::FieldDescriptor::Label label)
+{
+    switch(label) {
+        case gp::FieldDescriptor::LABEL_OPTIONAL:
+            return "optional";
+        case gp::FieldDescriptor::LABEL_REPEATED:
+            return "repeated";
+        case gp::FieldDescriptor::LABEL_REQUIRED:
+            return "required";
+        default:
+            return "<unknown>";
+    }
+}
+
+/**
+ * Returns @p value formatted like printf's "%g".
+ */
+static std::string formatNumber(double value)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%g", value);
+    return buffer;
+}
+
+/**
+ * Returns the default value for the field described by @p fieldDescriptor.
+ *
+ * The field must be of scalar or enum type. If the field has no default value,
+ * an empty string is returned.
+ */
+static std::string defaultValue(const gp::FieldDescriptor *fieldDescriptor)
+{
+    if (fieldDescriptor->has_default_value()) {
+        switch (fieldDescriptor->cpp_type()) {
+            case gp::FieldDescriptor::CPPTYPE_STRING: {
+                const std::string &value = fieldDescriptor->default_value_string();
+                if (fieldDescriptor->type() == gp::FieldDescriptor::TYPE_STRING) {
+                    return "\"" + value + "\"";
+                } else if (fieldDescriptor->type() == gp::FieldDescriptor::TYPE_BYTES) {
+                    static const char digits[] = "0123456789abcdef";
+                    std::string hex = "0x";
+                    for (const char ch : std::string_view(value.c_str())) {
+                        hex += digits[static_cast<unsigned char>(ch) >> 4];
+                        hex += digits[static_cast<unsigned char>(ch) & 0xf];
+                    }
+                    return hex;
+                } else {
+                    return "Unknown";
+                }
+            }
+            case gp::FieldDescriptor::CPPTYPE_BOOL:
+                return fieldDescriptor->default_value_bool() ? "true" : "false";
+            case gp::FieldDescriptor::CPPTYPE_FLOAT:
+                return formatNumber(fieldDescriptor->default_value_float());
+            case gp::FieldDescriptor::CPPTYPE_DOUBLE:
+                return formatNumber(fieldDescriptor->default_value_double());
+            case gp::FieldDescriptor::CPPTYPE_INT32:
+                return std::to_string(fieldDescriptor->default_value_int32());
+            case gp::FieldDescriptor::CPPTYPE_INT64:
+                return std::to_string(fieldDescriptor->default_value_int64());
+            case gp::FieldDescriptor::CPPTYPE_UINT32:
+                return std::to_string(fieldDescriptor->default_value_uint32());
+            case gp::FieldDescriptor::CPPTYPE_UINT64:
+                return std::to_string(fieldDescriptor->default_value_uint64());
+            case gp::FieldDescriptor::CPPTYPE_ENUM:
+                return fieldDescriptor->default_value_enum()->name();
+            default:
+                return "Unknown";
+        }
+    } else {
+        return std::string();
+    }
+}
+
+/**
+ * Add field to model list.
+ *
+ * Adds the field described by @p fieldDescriptor to the list @p fields.
+ */
+static void addField(const gp::FieldDescriptor *fieldDescriptor, const ExtractOptions &options,
+                     ms::Value::list_t *fields)
+{
+    bool excluded = false;
+    std::string description = descriptionOf(fieldDescriptor, options, excluded);
+
+    if (excluded) {
+        return;
+    }
+
+    ms::Value field;
+
+    // Add basic info.
+    field["field_name"] = ms::Value::view(fieldDescriptor->name());
+    field["field_description"] = std::move(description);
+    field["field_label"] = ms::Value::view(labelName(fieldDescriptor->label()));
+    field["field_default_value"] = defaultValue(fieldDescriptor);
+
+    // Add type information.
+    gp::FieldDescriptor::Type type = fieldDescriptor->type();
+    if (type == gp::FieldDescriptor::TYPE_MESSAGE || type == gp::FieldDescriptor::TYPE_GROUP) {
+        // Field is of message / group type.
+        const gp::Descriptor *descriptor = fieldDescriptor->message_type();
+        field["field_type"] = ms::Value::view(descriptor->name());
+        field["field_long_type"] = longName(descriptor);
+        field["field_full_type"] = ms::Value::view(descriptor->full_name());
+    } else if (type == gp::FieldDescriptor::TYPE_ENUM) {
+        // Field is of enum type.
+        const gp::EnumDescriptor *descriptor = fieldDescriptor->enum_type();
+        field["field_type"] = ms::Value::view(descriptor->name());
+        field["field_long_type"] = longName(descriptor);
+        field["field_full_type"] = ms::Value::view(descriptor->full_name());
+    } else {
+        // Field is of scalar type.
+        ms::Value typeName = ms::Value::view(scalarTypeName(type));
+        field["field_type"] = typeName;
+        field["field_long_type"] = typeName;
+        field["field_full_type"] = typeName;
+    }
+
+    fields->push_back(std::move(field));
+}
+
+/**
+ * Add extension to model list.
+ *
+ * Adds the extension described by @p fieldDescriptor to the list @p extensions.
+ */
+static void addExtension(const gp::FieldDescriptor *fieldDescriptor, const ExtractOptions &options,
+                         ms::Value::list_t *extensions)
+{
+    if (!options.selection.selectsName(fieldDescriptor->full_name())) {
+        return;
+    }
+
+    bool excluded = false;
+    std::string description = descriptionOf(fieldDescriptor, options, excluded);
+
+    if (excluded) {
+        return;
+    }
+
+    ms::Value extension;
+
+    // Add basic info.
+    extension["extension_name"] = ms::Value::view(fieldDescriptor->name());
+    extension["extension_full_name"] = ms::Value::view(fieldDescriptor->full_name());
+    extension["extension_long_name"] = longName(fieldDescriptor);
+    extension["extension_description"] = std::move(description);
+    extension["extension_label"] = ms::Value::view(labelName(fieldDescriptor->label()));
+    extension["extension_number"] = std::to_string(fieldDescriptor->number());
+    extension["extension_default_value"] = defaultValue(fieldDescriptor);
+
+    if (fieldDescriptor->is_extension()) {
+        const gp::Descriptor *descriptor = fieldDescriptor->extension_scope();
+        if (descriptor != NULL) {
+            extension["extension_scope_type"] = ms::Value::view(descriptor->name());
+            extension["extension_scope_long_type"] = longName(descriptor);
+            extension["extension_scope_full_type"] = ms::Value::view(descriptor->full_name());
+        }
+
+        descriptor = fieldDescriptor->containing_type();
+        if (descriptor != NULL) {
+            extension["extension_containing_type"] = ms::Value::view(descriptor->name());
+            extension["extension_containing_long_type"] = longName(descriptor);
+            extension["extension_containing_full_type"] = ms::Value::view(descriptor->full_name());
+        }
+    }
+
+    // Add type information.
+    gp::FieldDescriptor::Type type = fieldDescriptor->type();
+    if (type == gp::FieldDescriptor::TYPE_MESSAGE || type == gp::FieldDescriptor::TYPE_GROUP) {
+        // Extension is of message / group type.
+        const gp::Descriptor *descriptor = fieldDescriptor->message_type();
+        extension["extension_type"] = ms::Value::view(descriptor->name());
+        extension["extension_long_type"] = longName(descriptor);
+        extension["extension_full_type"] = ms::Value::view(descriptor->full_name());
+    } else if (type == gp::FieldDescriptor::TYPE_ENUM) {
+        // Extension is of enum type.
+        const gp::EnumDescriptor *descriptor = fieldDescriptor->enum_type();
+        extension["extension_type"] = ms::Value::view(descriptor->name());
+        extension["extension_long_type"] = longName(descriptor);
+        extension["extension_full_type"] = ms::Value::view(descriptor->full_name());
+    } else {
+        // Extension is of scalar type.
+        ms::Value typeName = ms::Value::view(scalarTypeName(type));
+        extension["extension_type"] = typeName;
+        extension["extension_long_type"] = typeName;
+        extension["extension_full_type"] = typeName;
+    }
+
+    extensions->push_back(std::move(extension));
+}
+
+/**
+ * Adds the enum described by @p enumDescriptor to the list @p enums.
+ */
+static void addEnum(const gp::EnumDescriptor *enumDescriptor, const ExtractOptions &options,
+                    ms::Value::list_t *enums)
+{
+    if (!options.selection.selectsName(enumDescriptor->full_name())) {
+        return;
+    }
+
+    bool excluded = false;
+    std::string description = descriptionOf(enumDescriptor, options, excluded);
+
+    if (excluded) {
+        return;
+    }
+
+    ms::Value enum_;
+
+    // Add basic info.
+    enum_["enum_name"] = ms::Value::view(enumDescriptor->name());
+    enum_["enum_long_name"] = longName(enumDescriptor);
+    enum_["enum_full_name"] = ms::Value::view(enumDescriptor->full_name());
+    enum_["enum_description"] = std::move(description);
+
+    // Add enum values.
+    ms::Value::list_t values;
+    for (int i = 0; i < enumDescriptor->value_count(); ++i) {
+        const gp::EnumValueDescriptor *valueDescriptor = enumDescriptor->value(i);
+
+        bool excluded = false;
+        std::string description = descriptionOf(valueDescriptor, options, excluded);
+
+        if (excluded) {
+            continue;
+        }
+
+        ms::Value value;
+        value["value_name"] = ms::Value::view(valueDescriptor->name());
+        value["value_number"] = valueDescriptor->number();
+        value["value_description"] = std::move(description);
+        values.push_back(std::move(value));
+    }
+    enum_["enum_values"] = std::move(values);
+    addHash("enum_hash", options, &enum_);
+
+    enums->push_back(std::move(enum_));
+}
+
+/**
+ * Adds the message described by @p descriptor to the list @p messages.
+ *
+ * @return false if the message is excluded with an @exclude directive,
+ * otherwise true.
+ */
+static bool addMessage(const gp::Descriptor *descriptor, const ExtractOptions &options,
+                       ms::Value::list_t *messages)
+{
+    bool excluded = false;
+    std::string description = descriptionOf(descriptor, options, excluded);
+
+    if (excluded) {
+        return false;
+    }
+
+    ms::Value message;
+
+    // Add basic info.
+    message["message_name"] = ms::Value::view(descriptor->name());
+    message["message_long_name"] = longName(descriptor);
+    message["message_full_name"] = ms::Value::view(descriptor->full_name());
+    message["message_description"] = std::move(description);
+
+    // Add fields.
+    ms::Value::list_t fields;
+    for (int i = 0; i < descriptor->field_count(); ++i) {
+        addField(descriptor->field(i), options, &fields);
+    }
+    message["message_fields"] = std::move(fields);
+
+    // Add nested extensions.
+    ms::Value::list_t extensions;
+    for (int i = 0; i < descriptor->extension_count(); ++i) {
+        addExtension(descriptor->extension(i), options, &extensions);
+    }
+    message["message_has_extensions"] = !extensions.empty();
+    message["message_extensions"] = std::move(extensions);
+    addHash("message_hash", options, &message);
+
+    messages->push_back(std::move(message));
+    return true;
+}
+
+/**
+ * Add messages to model list.
+ *
+ * Adds the message described by @p descriptor and all its nested messages and
+ * enums to the lists @p messages and @p enums, respectively, as far as they are
+ * selected.
+ */
+static void addMessages(const gp::Descriptor *descriptor,
+                        const ExtractOptions &options,
+                        ms::Value::list_t *messages,
+                        ms::Value::list_t *enums)
+{
+    // A message excluded by name is skipped with everything nested in it, while
+    // one that is merely not included may have nested elements that are.
+    if (options.selection.excludesName(descriptor->full_name())) {
+        return;
+    }
+    if (options.selection.selectsName(descriptor->full_name()) &&
+            !addMessage(descriptor, options, messages)) {
+        return;
+    }
+
+    // Add nested messages and enums.
+    for (int i = 0; i < descriptor->nested_type_count(); ++i) {
+        addMessages(descriptor->nested_type(i), options, messages, enums);
+    }
+    for (int i = 0; i < descriptor->enum_type_count(); ++i) {
+        addEnum(descriptor->enum_type(i), options, enums);
+    }
+}
+
+/**
+ * Add services to model list.
+ *
+ * Adds the service described by @p serviceDescriptor and all its methods to the
+ * list @p services.
+ */
+static void addService(const gp::ServiceDescriptor *serviceDescriptor, const ExtractOptions &options,
+                       ms::Value::list_t *services)
+{
+    if (!options.selection.selectsName(serviceDescriptor->full_name())) {
+        return;
+    }
+
+    bool excluded = false;
+    std::string description = descriptionOf(serviceDescriptor, options, excluded);
+    
+    if (excluded) {
+        return;
+    }
+    
+    ms::Value service;
+    
+    // Add basic info.
+    service["service_name"] = ms::Value::view(serviceDescriptor->name());
+    service["service_full_name"] = ms::Value::view(serviceDescriptor->full_name());
+    service["service_description"] = std::move(description);
+    
+    // Add methods.
+    ms::Value::list_t methods;
+    for (int i = 0; i < serviceDescriptor->method_count(); ++i) {
+        const gp::MethodDescriptor *methodDescriptor = serviceDescriptor->method(i);
+        
+        bool excluded = false;
+        std::string description = descriptionOf(methodDescriptor, options, excluded);
+        
+        if (excluded) {
+            continue;
+        }
+        
+        ms::Value method;
+        method["method_name"] = ms::Value::view(methodDescriptor->name());
+        method["method_description"] = std::move(description);
+        
+        // Add type for method input
+        method["method_request_type"] = ms::Value::view(methodDescriptor->input_type()->name());
+        method["method_request_full_type"] = ms::Value::view(methodDescriptor->input_type()->full_name());
+        method["method_request_long_type"] = longName(methodDescriptor->input_type());
+        
+        // Add type for method output
+        method["method_response_type"] = ms::Value::view(methodDescriptor->output_type()->name());
+        method["method_response_full_type"] = ms::Value::view(methodDescriptor->output_type()->full_name());
+        method["method_response_long_type"] = longName(methodDescriptor->output_type());
+        
+        methods.push_back(std::move(method));
+    }
+    service["service_methods"] = std::move(methods);
+    addHash("service_hash", options, &service);
+    
+    services->push_back(std::move(service));
+}
+
+void addFile(const gp::FileDescriptor *fileDescriptor, const ExtractOptions &options,
+             ms::Value *files, std::string *error)
+{
+    // Check the selection before reading anything from the file.
+    if (!options.selection.selectsFile(fileDescriptor)) {
+        return;
+    }
+
+    bool excluded = false;
+    std::string description = descriptionOf(fileDescriptor, options, error, excluded);
+
+    if (excluded) {
+        return;
+    }
+
+    ms::Value file;
+
+    // Add basic info.
+    const std::string &fileName = fileDescriptor->name();
+    file["file_name"] = ms::Value::view(std::string_view(fileName).substr(fileName.find_last_of('/') + 1));
+    file["file_path"] = ms::Value::view(fileName);
+    file["file_description"] = std::move(description);
+    file["file_package"] = ms::Value::view(fileDescriptor->package());
+
+    ms::Value::list_t messages;
+    ms::Value::list_t enums;
+    ms::Value::list_t services;
+    ms::Value::list_t extensions;
+
+    // Add messages.
+    for (int i = 0; i < fileDescriptor->message_type_count(); ++i) {
+        addMessages(fileDescriptor->message_type(i), options, &messages, &enums);
+    }
+    std::sort(messages.begin(), messages.end(), &longNameLessThan);
+    file["file_messages"] = std::move(messages);
+
+    // Add enums.
+    for (int i = 0; i < fileDescriptor->enum_type_count(); ++i) {
+        addEnum(fileDescriptor->enum_type(i), options, &enums);
+    }
+    std::sort(enums.begin(), enums.end(), &longNameLessThan);
+    file["file_enums"] = std::move(enums);
+
+    // Add services.
+    for (int i = 0; i < fileDescriptor->service_count(); ++i) {
+        addService(fileDescriptor->service(i), options, &services);
+    }
+    std::sort(services.begin(), services.end(), &longNameLessThan);
+    file["file_has_services"] = !services.empty();
+    file["file_services"] = std::move(services);
+    
+    // Add file-level extensions
+    for (int i = 0; i < fileDescriptor->extension_count(); ++i) {
+        addExtension(fileDescriptor->extension(i), options, &extensions);
+    }
+    std::sort(extensions.begin(), extensions.end(), &longNameLessThan);
+    file["file_has_extensions"] = !extensions.empty();
+    file["file_extensions"] = std::move(extensions);
+    addHash("file_hash", options, &file);
+
+    files->append(std::move(file));
+}
+
+ms::Value detached(const ms::Value &value)
+{
+    switch (value.type()) {
+    case ms::Value::String:
+        return ms::Value(std::string(value.text()));
+    case ms::Value::List:
+    {
+        ms::Value::list_t list;
+        list.reserve(value.size());
+        for (const ms::Value &item : value.list()) {
+            list.push_back(detached(item));
+        }
+        return list;
+    }
+    case ms::Value::Map:
+    {
+        ms::Value::map_t map;
+        map.reserve(value.size());
+        for (const auto &entry : value.map()) {
+            map.emplace_back(entry.first, detached(entry.second));
+        }
+        return map;
+    }
+    default:
+        return value;
+    }
+}
+
+} // namespace protocdoc
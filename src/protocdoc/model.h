@@ -0,0 +1,87 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "mustache.h"
+#include "selection.h"
+
+#include <functional>
+#include <string>
+
+namespace google {
+namespace protobuf {
+class FileDescriptor;
+}
+}
+
+namespace protocdoc {
+
+/**
+ * Options for extracting the documentation model from descriptors.
+ */
+struct ExtractOptions {
+    bool noExclude = false;     /**< Ignore @exclude directives? */
+
+    /**
+     * Maps the name of a file descriptor to the path of the file on disk, which
+     * the file description is read from. If not set, the name is used as is,
+     * relative to the working directory.
+     */
+    std::function<std::string(const std::string &name)> diskFileName;
+
+    /**
+     * Take file descriptions from the source info of the file descriptors instead
+     * of reading the files? Needed when the descriptors come from a descriptor
+     * set built with --include_source_info and the files may be absent.
+     */
+    bool descriptionFromSourceInfo = false;
+
+    /**
+     * Add a hash of the extracted contents of each file, message, enum and
+     * service under "file_hash", "message_hash", "enum_hash" and "service_hash",
+     * respectively? The hash of an element only changes if its documentation
+     * does, see manifest().
+     */
+    bool elementHashes = false;
+
+    /**
+     * Files and elements to extract. Those not selected are skipped without
+     * being visited, see Selection.
+     */
+    Selection selection;
+};
+
+/**
+ * Add file to model list.
+ *
+ * Adds the file described by @p fileDescriptor to the list @p files, unless it
+ * is excluded or not selected. If an error occurs, @p error is set to point to
+ * an error message and the function returns immediately.
+ *
+ * The description of the file is read from the file itself, see
+ * ExtractOptions::diskFileName and ExtractOptions::descriptionFromSourceInfo. Strings in the added value refer to
+ * the descriptors where possible, so the value must not outlive the descriptor
+ * pool unless it is passed through detached().
+ */
+void addFile(const google::protobuf::FileDescriptor *fileDescriptor, const ExtractOptions &options,
+             Mustache::Value *files, std::string *error);
+
+/**
+ * Returns @p value with all strings copied, so that it does not refer to
+ * descriptors that are destroyed when the request is done.
+ */
+Mustache::Value detached(const Mustache::Value &value);
+
+} // namespace protocdoc
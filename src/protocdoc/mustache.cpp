@@ -0,0 +1,1328 @@
+/*
+  Copyright 2012, Robert Knight
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "mustache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+
+using namespace Mustache;
+
+std::string Mustache::renderTemplate(std::string_view templateString, const Value& args)
+{
+	Mustache::ValueContext context(args);
+	Mustache::Renderer renderer;
+	return renderer.render(templateString, &context);
+}
+
+namespace
+{
+
+/** Returns true if @p ch is an ASCII whitespace character.
+  *
+  * Multi-byte UTF-8 sequences never contain ASCII bytes, so this is safe to use
+  * on any byte of UTF-8 text.
+  */
+bool isSpace(char ch)
+{
+	return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\v' || ch == '\f' || ch == '\r';
+}
+
+void appendEscapedHtml(std::string* output, std::string_view input)
+{
+	size_t last = 0;
+	for (size_t i = 0; i < input.size(); ++i) {
+		const char* replacement = 0;
+		char ch = input[i];
+		if (ch == '&') {
+			replacement = "&amp;";
+		} else if (ch == '<') {
+			replacement = "&lt;";
+		} else if (ch == '>') {
+			replacement = "&gt;";
+		} else if (ch == '"') {
+			replacement = "&quot;";
+		}
+		if (replacement) {
+			output->append(input.data() + last, i - last);
+			output->append(replacement);
+			last = i + 1;
+		}
+	}
+	output->append(input.data() + last, input.size() - last);
+}
+
+void replaceAll(std::string* text, std::string_view before, std::string_view after)
+{
+	size_t pos = 0;
+	while ((pos = text->find(before, pos)) != std::string::npos) {
+		text->replace(pos, before.size(), after);
+		pos += after.size();
+	}
+}
+
+void appendUnescapedHtml(std::string* output, std::string_view escaped)
+{
+	std::string unescaped(escaped);
+	replaceAll(&unescaped, "&lt;", "<");
+	replaceAll(&unescaped, "&gt;", ">");
+	replaceAll(&unescaped, "&amp;", "&");
+	replaceAll(&unescaped, "&quot;", "\"");
+	output->append(unescaped);
+}
+
+}
+
+Value::Value()
+{
+}
+
+Value::Value(bool value)
+	: m_data(value)
+{
+}
+
+Value::Value(int value)
+	: m_data(static_cast<long long>(value))
+{
+}
+
+Value::Value(long long value)
+	: m_data(value)
+{
+}
+
+Value::Value(const char* text)
+	: m_data(std::string(text))
+{
+}
+
+Value::Value(std::string text)
+	: m_data(std::move(text))
+{
+}
+
+Value::Value(list_t list)
+	: m_data(std::move(list))
+{
+}
+
+Value::Value(map_t map)
+	: m_data(std::move(map))
+{
+}
+
+Value::Value(fn_t fn)
+	: m_data(std::move(fn))
+{
+}
+
+Value Value::view(std::string_view text)
+{
+	Value value;
+	value.m_data = text;
+	return value;
+}
+
+Value::Type Value::type() const
+{
+	switch (m_data.index()) {
+	case 1:
+		return Bool;
+	case 2:
+		return Number;
+	case 3:
+	case 4:
+		return String;
+	case 5:
+		return List;
+	case 6:
+		return Map;
+	case 7:
+		return Function;
+	default:
+		return Null;
+	}
+}
+
+bool Value::isNull() const
+{
+	return m_data.index() == 0;
+}
+
+bool Value::toBool() const
+{
+	const bool* value = std::get_if<bool>(&m_data);
+	return value && *value;
+}
+
+long long Value::toNumber() const
+{
+	const long long* value = std::get_if<long long>(&m_data);
+	return value ? *value : 0;
+}
+
+std::string_view Value::text() const
+{
+	if (const std::string* text = std::get_if<std::string>(&m_data)) {
+		return *text;
+	} else if (const std::string_view* text = std::get_if<std::string_view>(&m_data)) {
+		return *text;
+	}
+	return std::string_view();
+}
+
+const Value::list_t& Value::list() const
+{
+	static const list_t empty;
+	const list_t* list = std::get_if<list_t>(&m_data);
+	return list ? *list : empty;
+}
+
+const Value::map_t& Value::map() const
+{
+	static const map_t empty;
+	const map_t* map = std::get_if<map_t>(&m_data);
+	return map ? *map : empty;
+}
+
+const Value::fn_t& Value::function() const
+{
+	static const fn_t empty;
+	const fn_t* fn = std::get_if<fn_t>(&m_data);
+	return fn ? *fn : empty;
+}
+
+const Value* Value::find(std::string_view key) const
+{
+	if (const map_t* map = std::get_if<map_t>(&m_data)) {
+		for (const auto& entry : *map) {
+			if (entry.first == key) {
+				return &entry.second;
+			}
+		}
+	}
+	return nullptr;
+}
+
+Value& Value::operator[](std::string_view key)
+{
+	if (isNull()) {
+		m_data = map_t();
+	}
+	map_t& map = std::get<map_t>(m_data);
+	for (auto& entry : map) {
+		if (entry.first == key) {
+			return entry.second;
+		}
+	}
+	map.emplace_back(std::string(key), Value());
+	return map.back().second;
+}
+
+void Value::append(Value value)
+{
+	if (isNull()) {
+		m_data = list_t();
+	}
+	std::get<list_t>(m_data).push_back(std::move(value));
+}
+
+size_t Value::size() const
+{
+	if (const list_t* list = std::get_if<list_t>(&m_data)) {
+		return list->size();
+	} else if (const map_t* map = std::get_if<map_t>(&m_data)) {
+		return map->size();
+	}
+	return 0;
+}
+
+bool Value::isEmpty() const
+{
+	return size() == 0;
+}
+
+Context::Context(PartialResolver* resolver)
+	: m_partialResolver(resolver)
+{}
+
+PartialResolver* Context::partialResolver() const
+{
+	return m_partialResolver;
+}
+
+std::string Context::partialValue(std::string_view key) const
+{
+	if (!m_partialResolver) {
+		return std::string();
+	}
+	return m_partialResolver->getPartial(key);
+}
+
+bool Context::canEval(std::string_view) const
+{
+	return false;
+}
+
+std::string Context::eval(std::string_view key, std::string_view _template, Renderer* renderer)
+{
+	(void)key;
+	(void)_template;
+	(void)renderer;
+
+	return std::string();
+}
+
+bool Context::fingerprint(std::string_view, std::string*) const
+{
+	return false;
+}
+
+ValueContext::ValueContext(const Value& root, PartialResolver* resolver)
+	: Context(resolver)
+{
+	m_contextStack.push_back(&root);
+}
+
+const Value* valueForKeyPath(const Value* value, std::string_view keyPath)
+{
+	size_t dot;
+	while ((dot = keyPath.find('.')) != std::string_view::npos) {
+		value = value->find(keyPath.substr(0, dot));
+		if (!value) {
+			return nullptr;
+		}
+		keyPath.remove_prefix(dot + 1);
+	}
+	return value->find(keyPath);
+}
+
+const Value* ValueContext::value(std::string_view key) const
+{
+	if (key == "." && !m_contextStack.empty()) {
+		return m_contextStack.back();
+	}
+	for (auto it = m_contextStack.rbegin(); it != m_contextStack.rend(); ++it) {
+		const Value* value = valueForKeyPath(*it, key);
+		if (value && !value->isNull()) {
+			return value;
+		}
+	}
+	return nullptr;
+}
+
+bool ValueContext::isFalse(std::string_view key) const
+{
+	const Value* value = this->value(key);
+	if (!value) {
+		return true;
+	}
+	switch (value->type()) {
+	case Value::Bool:
+		return !value->toBool();
+	case Value::Number:
+		return false;
+	case Value::String:
+		return value->text().empty();
+	case Value::List:
+	case Value::Map:
+		return value->isEmpty();
+	default:
+		return true;
+	}
+}
+
+std::string_view ValueContext::stringValue(std::string_view key) const
+{
+	if (isFalse(key)) {
+		return std::string_view();
+	}
+	const Value* value = this->value(key);
+	switch (value->type()) {
+	case Value::Bool:
+		return "true";
+	case Value::Number:
+		m_number = std::to_string(value->toNumber());
+		return m_number;
+	default:
+		return value->text();
+	}
+}
+
+void ValueContext::push(std::string_view key, int index)
+{
+	static const Value null;
+	const Value* mapItem = value(key);
+	if (!mapItem) {
+		m_contextStack.push_back(&null);
+	} else if (index == -1) {
+		m_contextStack.push_back(mapItem);
+	} else {
+		const Value::list_t& list = mapItem->list();
+		m_contextStack.push_back(index < static_cast<int>(list.size()) ? &list[index] : &null);
+	}
+}
+
+void ValueContext::pop()
+{
+	m_contextStack.pop_back();
+}
+
+int ValueContext::listCount(std::string_view key) const
+{
+	const Value* value = this->value(key);
+	if (value && value->type() == Value::List) {
+		return static_cast<int>(value->size());
+	}
+	return 0;
+}
+
+bool ValueContext::canEval(std::string_view key) const
+{
+	const Value* value = this->value(key);
+	return value && value->type() == Value::Function;
+}
+
+std::string ValueContext::eval(std::string_view key, std::string_view _template, Renderer* renderer)
+{
+	const Value* fn = value(key);
+	if (!fn || !fn->function()) {
+		return std::string();
+	}
+	return fn->function()(_template, renderer, this);
+}
+
+namespace
+{
+
+// Fingerprints larger than this are replaced by the address of the value.
+const size_t MaxFingerprintSize = 256;
+
+void appendAddress(const Value* value, std::string* out)
+{
+	out->push_back('@');
+	out->append(std::to_string(reinterpret_cast<std::uintptr_t>(value)));
+	out->push_back(';');
+}
+
+bool appendFingerprint(const Value& value, std::string* out, size_t limit)
+{
+	switch (value.type()) {
+	case Value::Null:
+		out->push_back('n');
+		break;
+	case Value::Bool:
+		out->push_back(value.toBool() ? 't' : 'f');
+		break;
+	case Value::Number:
+		out->push_back('i');
+		out->append(std::to_string(value.toNumber()));
+		out->push_back(';');
+		break;
+	case Value::String:
+		out->push_back('s');
+		out->append(std::to_string(value.text().size()));
+		out->push_back(':');
+		out->append(value.text());
+		break;
+	case Value::List:
+		out->push_back('[');
+		for (const Value& item : value.list()) {
+			if (out->size() > limit || !appendFingerprint(item, out, limit)) {
+				return false;
+			}
+		}
+		out->push_back(']');
+		break;
+	case Value::Map:
+		out->push_back('{');
+		for (const auto& entry : value.map()) {
+			out->append(std::to_string(entry.first.size()));
+			out->push_back(':');
+			out->append(entry.first);
+			if (out->size() > limit || !appendFingerprint(entry.second, out, limit)) {
+				return false;
+			}
+		}
+		out->push_back('}');
+		break;
+	case Value::Function:
+		// Lambdas are identified by their address, they may capture anything.
+		appendAddress(&value, out);
+		break;
+	}
+	return out->size() <= limit;
+}
+
+}
+
+bool ValueContext::fingerprint(std::string_view key, std::string* out) const
+{
+	const Value* value = this->value(key);
+	if (!value) {
+		out->push_back('n');
+		return true;
+	}
+	// The model is not modified while rendering, so a value which is too large
+	// to compare by content can be identified by its address instead.
+	const size_t start = out->size();
+	if (!appendFingerprint(*value, out, start + MaxFingerprintSize)) {
+		out->resize(start);
+		appendAddress(value, out);
+	}
+	return true;
+}
+
+PartialMap::PartialMap(const std::unordered_map<std::string, std::string>& partials)
+	: m_partials(partials)
+{}
+
+std::string PartialMap::getPartial(std::string_view name)
+{
+	auto it = m_partials.find(std::string(name));
+	return it == m_partials.end() ? std::string() : it->second;
+}
+
+PartialFileLoader::PartialFileLoader(const std::string& basePath)
+	: m_basePath(basePath)
+{}
+
+std::string PartialFileLoader::getPartial(std::string_view name)
+{
+	std::string key(name);
+	auto it = m_cache.find(key);
+	if (it == m_cache.end()) {
+		std::string path = m_basePath + '/' + key + ".mustache";
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		if (!file) {
+			return std::string();
+		}
+		std::ostringstream stream;
+		stream << file.rdbuf();
+		it = m_cache.emplace(key, stream.str()).first;
+	}
+	return it->second;
+}
+
+namespace
+{
+
+/** Compiles template source into a tree of nodes.
+  *
+  * All state which is modified while scanning a template (the current tag
+  * markers and the first error) lives here, so compiling is reentrant.
+  */
+class Parser
+{
+public:
+	Parser(std::string_view content, std::string_view startMarker, std::string_view endMarker)
+		: m_content(content)
+		, m_tagStartMarker(startMarker)
+		, m_tagEndMarker(endMarker)
+		, m_errorPos(-1)
+	{}
+
+	void parse(int startPos, int endPos, std::vector<Node>* nodes);
+
+	std::string error() const { return m_error; }
+	int errorPos() const { return m_errorPos; }
+
+private:
+	Tag findTag(int pos, int endPos);
+	Tag findEndTag(const Tag& startTag, int endPos);
+	void setError(const std::string& error, int pos);
+
+	void readSetDelimiter(int pos, int endPos);
+	std::string_view readTagName(int pos, int endPos) const;
+	int indexOf(std::string_view text, int pos) const;
+
+	/** Expands @p tag to fill the line, but only if it is standalone.
+	 *
+	 * The start position is moved to the beginning of the line. The end position is
+	 * moved to one past the end of the line. If @p tag is not standalone, it is
+	 * left unmodified.
+	 *
+	 * A tag is standalone if it is the only non-whitespace token on the the line.
+	 */
+	void expandTag(Tag& tag) const;
+
+	std::string_view m_content;
+	std::string m_tagStartMarker;
+	std::string m_tagEndMarker;
+	std::string m_error;
+	int m_errorPos;
+};
+
+void appendText(std::vector<Node>* nodes, std::string_view content, int pos, int length)
+{
+	if (length <= 0) {
+		return;
+	}
+	Node node;
+	node.type = Node::Text;
+	node.pos = pos;
+	node.text = content.substr(pos, length);
+	nodes->push_back(node);
+}
+
+void Parser::parse(int startPos, int endPos, std::vector<Node>* nodes)
+{
+	int lastTagEnd = startPos;
+
+	while (m_errorPos == -1) {
+		Tag tag = findTag(lastTagEnd, endPos);
+		if (tag.type == Tag::Null) {
+			appendText(nodes, m_content, lastTagEnd, endPos - lastTagEnd);
+			break;
+		}
+		appendText(nodes, m_content, lastTagEnd, tag.start - lastTagEnd);
+		switch (tag.type) {
+		case Tag::Value:
+		{
+			Node node;
+			node.type = Node::Value;
+			node.pos = tag.start;
+			node.text = tag.key;
+			node.escapeMode = tag.escapeMode;
+			nodes->push_back(node);
+			lastTagEnd = tag.end;
+		}
+		break;
+		case Tag::SectionStart:
+		case Tag::InvertedSectionStart:
+		{
+			Tag endTag = findEndTag(tag, endPos);
+			if (endTag.type == Tag::Null) {
+				if (m_errorPos == -1) {
+					setError(tag.type == Tag::SectionStart
+					         ? "No matching end tag found for section"
+					         : "No matching end tag found for inverted section", tag.start);
+				}
+			} else {
+				Node node;
+				node.type = tag.type == Tag::SectionStart ? Node::Section : Node::InvertedSection;
+				node.pos = tag.start;
+				node.text = tag.key;
+				node.source = m_content.substr(tag.end, endTag.start - tag.end);
+				parse(tag.end, endTag.start, &node.children);
+				nodes->push_back(std::move(node));
+				lastTagEnd = endTag.end;
+			}
+		}
+		break;
+		case Tag::SectionEnd:
+			setError("Unexpected end tag", tag.start);
+			lastTagEnd = tag.end;
+			break;
+		case Tag::Partial:
+		{
+			Node node;
+			node.type = Node::Partial;
+			node.pos = tag.start;
+			node.text = tag.key;
+			nodes->push_back(node);
+			lastTagEnd = tag.end;
+		}
+		break;
+		case Tag::SetDelimiter:
+			lastTagEnd = tag.end;
+			break;
+		case Tag::Comment:
+			lastTagEnd = tag.end;
+			break;
+		case Tag::Null:
+			break;
+		}
+	}
+}
+
+void Parser::setError(const std::string& error, int pos)
+{
+	assert(!error.empty());
+	assert(pos >= 0);
+
+	m_error = error;
+	m_errorPos = pos;
+}
+
+int Parser::indexOf(std::string_view text, int pos) const
+{
+	size_t index = m_content.find(text, pos);
+	return index == std::string_view::npos ? -1 : static_cast<int>(index);
+}
+
+Tag Parser::findTag(int pos, int endPos)
+{
+	const std::string_view content = m_content;
+
+	int tagStartPos = indexOf(m_tagStartMarker, pos);
+	if (tagStartPos == -1 || tagStartPos >= endPos) {
+		return Tag();
+	}
+
+	int tagEndPos = indexOf(m_tagEndMarker, tagStartPos + static_cast<int>(m_tagStartMarker.size()));
+	if (tagEndPos == -1) {
+		return Tag();
+	}
+	tagEndPos += m_tagEndMarker.size();
+
+	Tag tag;
+	tag.type = Tag::Value;
+	tag.start = tagStartPos;
+	tag.end = tagEndPos;
+
+	pos = tagStartPos + m_tagStartMarker.size();
+	endPos = tagEndPos - m_tagEndMarker.size();
+
+	char typeChar = content[pos];
+
+	if (typeChar == '#') {
+		tag.type = Tag::SectionStart;
+		tag.key = readTagName(pos+1, endPos);
+	} else if (typeChar == '^') {
+		tag.type = Tag::InvertedSectionStart;
+		tag.key = readTagName(pos+1, endPos);
+	} else if (typeChar == '/') {
+		tag.type = Tag::SectionEnd;
+		tag.key = readTagName(pos+1, endPos);
+	} else if (typeChar == '!') {
+		tag.type = Tag::Comment;
+	} else if (typeChar == '>') {
+		tag.type = Tag::Partial;
+		tag.key = readTagName(pos+1, endPos);
+	} else if (typeChar == '=') {
+		tag.type = Tag::SetDelimiter;
+		readSetDelimiter(pos+1, tagEndPos - m_tagEndMarker.size());
+	} else {
+		if (typeChar == '&') {
+			tag.escapeMode = Tag::Unescape;
+			++pos;
+		} else if (typeChar == '{') {
+			tag.escapeMode = Tag::Raw;
+			++pos;
+			int endTache = indexOf("}", pos);
+			if (endTache == tag.end - static_cast<int>(m_tagEndMarker.size())) {
+				++tag.end;
+			} else {
+				endPos = endTache;
+			}
+		}
+		tag.type = Tag::Value;
+		tag.key = readTagName(pos, endPos);
+	}
+
+	if (tag.type != Tag::Value) {
+		expandTag(tag);
+	}
+
+	return tag;
+}
+
+std::string_view Parser::readTagName(int pos, int endPos) const
+{
+	const std::string_view content = m_content;
+
+	while (pos < endPos && isSpace(content[pos])) {
+		++pos;
+	}
+	int start = pos;
+	while (pos < endPos && !isSpace(content[pos])) {
+		++pos;
+	}
+	return content.substr(start, pos - start);
+}
+
+void Parser::readSetDelimiter(int pos, int endPos)
+{
+	const std::string_view content = m_content;
+
+	std::string startMarker;
+	std::string endMarker;
+
+	while (isSpace(content[pos]) && pos < endPos) {
+		++pos;
+	}
+
+	while (!isSpace(content[pos]) && pos < endPos) {
+		if (content[pos] == '=') {
+			setError("Custom delimiters may not contain '='.", pos);
+			return;
+		}
+		startMarker += content[pos];
+		++pos;
+	}
+
+	while (isSpace(content[pos]) && pos < endPos) {
+		++pos;
+	}
+
+	while (!isSpace(content[pos]) && pos < endPos - 1) {
+		if (content[pos] == '=') {
+			setError("Custom delimiters may not contain '='.", pos);
+			return;
+		}
+		endMarker += content[pos];
+		++pos;
+	}
+
+	m_tagStartMarker = startMarker;
+	m_tagEndMarker = endMarker;
+}
+
+Tag Parser::findEndTag(const Tag& startTag, int endPos)
+{
+	int tagDepth = 1;
+	int pos = startTag.end;
+
+	while (true) {
+		Tag nextTag = findTag(pos, endPos);
+		if (nextTag.type == Tag::Null) {
+			return nextTag;
+		} else if (nextTag.type == Tag::SectionStart || nextTag.type == Tag::InvertedSectionStart) {
+			++tagDepth;
+		} else if (nextTag.type == Tag::SectionEnd) {
+			--tagDepth;
+			if (tagDepth == 0) {
+				if (nextTag.key != startTag.key) {
+					setError("Tag start/end key mismatch", nextTag.start);
+					return Tag();
+				}
+				return nextTag;
+			}
+		}
+		pos = nextTag.end;
+	}
+
+	return Tag();
+}
+
+void Parser::expandTag(Tag& tag) const
+{
+	const std::string_view content = m_content;
+	const int size = static_cast<int>(content.size());
+
+	int start = tag.start;
+	int end = tag.end;
+
+	// Move start to beginning of line.
+	while (start > 0 && content[start - 1] != '\n') {
+		--start;
+		if (!isSpace(content[start])) {
+			return; // Not standalone.
+		}
+	}
+
+	// Move end to one past end of line.
+	while (end <= size && content[end - 1] != '\n') {
+		if (end < size && !isSpace(content[end])) {
+			return; // Not standalone.
+		}
+		++end;
+	}
+
+	tag.start = start;
+	tag.end = std::min(end, size);
+}
+
+
+const size_t MaxMemoKeys = 8;
+
+void addKey(std::vector<std::string_view>* keys, std::string_view key)
+{
+	if (std::find(keys->begin(), keys->end(), key) == keys->end()) {
+		keys->push_back(key);
+	}
+}
+
+/** Adds the keys used by @p nodes to @p keys and marks the memoizable sections
+  * among them. Returns false if the output of @p nodes depends on anything but
+  * the values of those keys.
+  */
+bool collectMemoKeys(std::vector<Node>* nodes, std::vector<std::string_view>* keys)
+{
+	bool memoizable = true;
+	for (Node& node : *nodes) {
+		switch (node.type) {
+		case Node::Text:
+			break;
+		case Node::Value:
+		case Node::InvertedSection:
+		case Node::Section:
+		{
+			// Inside a section, "." is an item of the section's own value,
+			// which the fingerprint of the enclosing section key covers. Lambda
+			// sections render their body in the enclosing context instead, so
+			// renderSection() does not memoize them.
+			if (node.text != ".") {
+				addKey(keys, node.text);
+			}
+			if (node.type == Node::Value) {
+				break;
+			}
+			std::vector<std::string_view> childKeys;
+			const bool childrenMemoizable = collectMemoKeys(&node.children, &childKeys);
+			for (std::string_view key : childKeys) {
+				addKey(keys, key);
+			}
+			if (node.type == Node::Section) {
+				node.memoKeys.push_back(node.text);
+				for (std::string_view key : childKeys) {
+					addKey(&node.memoKeys, key);
+				}
+				// Fingerprinting many keys costs about as much as rendering, and
+				// sections using that many rarely render the same twice anyway.
+				node.memoizable = childrenMemoizable && node.memoKeys.size() <= MaxMemoKeys;
+			}
+			memoizable = memoizable && childrenMemoizable;
+		}
+		break;
+		case Node::Partial:
+			memoizable = false;
+			break;
+		}
+	}
+	return memoizable;
+}
+
+}
+
+Template::Template()
+	: d(std::make_shared<Data>())
+{
+}
+
+Template::Template(std::string source, std::string_view startMarker, std::string_view endMarker)
+	: d(compiled(std::move(source), startMarker, endMarker, nullptr))
+{
+}
+
+Template::Template(std::string source, RenderFunction function)
+	: d(compiled(std::move(source), "{{", "}}", function))
+{
+}
+
+std::shared_ptr<const Template::Data> Template::compiled(std::string source, std::string_view startMarker,
+                                                         std::string_view endMarker, RenderFunction function)
+{
+	std::shared_ptr<Data> data = std::make_shared<Data>();
+	data->source = std::move(source);
+	data->function = function;
+
+	Parser parser(data->source, startMarker, endMarker);
+	parser.parse(0, static_cast<int>(data->source.size()), &data->nodes);
+	data->error = parser.error();
+	data->errorPos = parser.errorPos();
+	if (data->errorPos != -1) {
+		data->nodes.clear();
+	}
+
+	std::vector<std::string_view> keys;
+	collectMemoKeys(&data->nodes, &keys);
+
+	return data;
+}
+
+bool Template::isValid() const
+{
+	return d->errorPos == -1;
+}
+
+std::string Template::error() const
+{
+	return d->error;
+}
+
+int Template::errorPos() const
+{
+	return d->errorPos;
+}
+
+std::string_view Template::source() const
+{
+	return d->source;
+}
+
+const std::vector<Node>& Template::nodes() const
+{
+	return d->nodes;
+}
+
+RenderFunction Template::renderFunction() const
+{
+	return d->function;
+}
+
+Renderer::Renderer()
+	: m_depth(0)
+	, m_errorPos(-1)
+	, m_evalPos(0)
+	, m_nesting(0)
+	, m_nodeCount(0)
+	, m_continued(false)
+	, m_priorOutput(0)
+	, m_memoization(false)
+	, m_memoSize(0)
+	, m_defaultTagStartMarker("{{")
+	, m_defaultTagEndMarker("}}")
+{
+}
+
+std::string Renderer::error() const
+{
+	return m_error;
+}
+
+int Renderer::errorPos() const
+{
+	return m_errorPos;
+}
+
+std::string Renderer::errorPartial() const
+{
+	return m_errorPartial;
+}
+
+std::string Renderer::render(std::string_view _template, Context* context)
+{
+	if (m_depth > 0) {
+		// Called from Context::eval() during a render, so reuse compiled sections.
+		return render(compiled(&m_sections, _template), context);
+	}
+	return render(Template(std::string(_template), m_defaultTagStartMarker, m_defaultTagEndMarker), context);
+}
+
+std::string Renderer::render(const Template& _template, Context* context)
+{
+	if (m_depth == 0) {
+		start();
+	}
+
+	std::string output;
+	if (!_template.isValid()) {
+		setError(_template.error(), _template.errorPos());
+		return output;
+	}
+
+	++m_depth;
+	if (_template.renderFunction()) {
+		_template.renderFunction()(context, this, &s_hooks, &output);
+	} else {
+		render(_template.nodes(), context, &output);
+	}
+	--m_depth;
+
+	return output;
+}
+
+void Renderer::render(const Template& _template, const std::vector<Node>& nodes, Context* context, std::string* output)
+{
+	start();
+
+	if (!_template.isValid()) {
+		setError(_template.error(), _template.errorPos());
+		return;
+	}
+
+	++m_depth;
+	render(nodes, context, output);
+	--m_depth;
+}
+
+void Renderer::start()
+{
+	m_error.clear();
+	m_errorPos = -1;
+	m_errorPartial.clear();
+	m_partialStack.clear();
+	m_evalPos = 0;
+	m_nesting = 0;
+	m_memos.clear();
+	m_memoSize = 0;
+	if (m_continued) {
+		// Keep counting nodes, so that the clock is read as often as for one call.
+		m_continued = false;
+		return;
+	}
+	m_nodeCount = 0;
+	m_priorOutput = 0;
+	if (m_limits.timeBudget.count() > 0) {
+		m_deadline = std::chrono::steady_clock::now() + m_limits.timeBudget;
+	}
+}
+
+void Renderer::render(const std::vector<Node>& nodes, Context* context, std::string* output)
+{
+	for (const Node& node : nodes) {
+		if (m_errorPos != -1) {
+			return;
+		}
+		switch (node.type) {
+		case Node::Text:
+			output->append(node.text);
+			break;
+		case Node::Value:
+		{
+			std::string_view value = context->stringValue(node.text);
+			if (node.escapeMode == Tag::Escape) {
+				appendEscapedHtml(output, value);
+			} else if (node.escapeMode == Tag::Unescape) {
+				appendUnescapedHtml(output, value);
+			} else {
+				output->append(value);
+			}
+		}
+		break;
+		case Node::Section:
+			renderSection(node, context, output);
+			break;
+		case Node::InvertedSection:
+			if (context->isFalse(node.text)) {
+				render(node.children, context, output);
+			}
+			break;
+		case Node::Partial:
+			renderPartial(node.text, node.pos, context, output);
+			break;
+		}
+		if (m_errorPos != -1 || !withinLimits(node.pos, *output)) {
+			return;
+		}
+	}
+}
+
+void Renderer::renderSection(const Node& node, Context* context, std::string* output)
+{
+	// Copying a kept output is only worth it for sections which repeat. Give up on
+	// those which rarely do after a few renders, and bound the memory held for a render.
+	const int MinRenders = 2;
+	const int MinMisses = 8;
+	const size_t MaxMemoizedOutput = 64 * 1024;
+	const size_t MaxMemoSize = 16 * 1024 * 1024;
+
+	Memo* memo = nullptr;
+	std::string fingerprint;
+	if (m_memoization && node.memoizable && !context->canEval(node.text)) {
+		memo = &m_memos[&node];
+		// Many sections are rendered only once or twice, so skip those.
+		if (memo->disabled || ++memo->renders <= MinRenders) {
+			memo = nullptr;
+		}
+		for (size_t i = 0; memo && i < node.memoKeys.size(); ++i) {
+			if (!context->fingerprint(node.memoKeys[i], &fingerprint)) {
+				memo->disabled = true;
+				memo = nullptr;
+			}
+		}
+	}
+	if (memo) {
+		auto it = memo->outputs.find(fingerprint);
+		if (it != memo->outputs.end()) {
+			++memo->hits;
+			output->append(it->second);
+			return;
+		}
+	}
+
+	if (!enter(node.pos)) {
+		return;
+	}
+	const size_t start = output->size();
+	int listCount = context->listCount(node.text);
+	if (listCount > 0) {
+		for (int i=0; i < listCount; i++) {
+			context->push(node.text, i);
+			render(node.children, context, output);
+			context->pop();
+		}
+	} else if (context->canEval(node.text)) {
+		eval(node.text, node.source, node.pos, context, output);
+	} else if (!context->isFalse(node.text)) {
+		context->push(node.text);
+		render(node.children, context, output);
+		context->pop();
+	}
+	--m_nesting;
+
+	if (!memo || m_errorPos != -1) {
+		return;
+	}
+	if (++memo->misses >= MinMisses && memo->misses > 4 * memo->hits) {
+		memo->disabled = true;
+		for (const auto& entry : memo->outputs) {
+			m_memoSize -= entry.first.size() + entry.second.size();
+		}
+		memo->outputs.clear();
+		return;
+	}
+	const size_t size = output->size() - start;
+	if (size <= MaxMemoizedOutput && m_memoSize + fingerprint.size() + size <= MaxMemoSize) {
+		m_memoSize += fingerprint.size() + size;
+		memo->outputs.emplace(std::move(fingerprint), output->substr(start));
+	}
+}
+
+void Renderer::renderPartial(std::string_view name, int pos, Context* context, std::string* output)
+{
+	if (!enter(pos)) {
+		return;
+	}
+	m_partialStack.push_back(std::string(name));
+
+	Template partial = compiled(&m_partials, context->partialValue(name));
+	if (!partial.isValid()) {
+		setError(partial.error(), partial.errorPos());
+	} else {
+		render(partial.nodes(), context, output);
+	}
+
+	m_partialStack.pop_back();
+	--m_nesting;
+}
+
+void Renderer::eval(std::string_view key, std::string_view body, int pos, Context* context, std::string* output)
+{
+	const int evalPos = m_evalPos;
+	m_evalPos = pos;
+	output->append(context->eval(key, body, this));
+	m_evalPos = evalPos;
+}
+
+const RenderHooks Renderer::s_hooks = {
+	&Renderer::renderPartialHook,
+	&Renderer::enterHook,
+	&Renderer::leaveHook,
+	&Renderer::evalHook,
+	&Renderer::withinLimitsHook
+};
+
+bool Renderer::renderPartialHook(Renderer* renderer, std::string_view name, int pos, Context* context,
+                                 std::string* output)
+{
+	renderer->renderPartial(name, pos, context, output);
+	return renderer->m_errorPos == -1;
+}
+
+bool Renderer::enterHook(Renderer* renderer, int pos)
+{
+	return renderer->enter(pos);
+}
+
+void Renderer::leaveHook(Renderer* renderer)
+{
+	--renderer->m_nesting;
+}
+
+bool Renderer::evalHook(Renderer* renderer, std::string_view key, std::string_view body, int pos,
+                        Context* context, std::string* output)
+{
+	renderer->eval(key, body, pos, context, output);
+	return renderer->m_errorPos == -1;
+}
+
+bool Renderer::withinLimitsHook(Renderer* renderer, int pos, const std::string& output)
+{
+	return renderer->m_errorPos == -1 && renderer->withinLimits(pos, output);
+}
+
+bool Renderer::enter(int pos)
+{
+	if (m_limits.maxDepth > 0 && m_nesting >= m_limits.maxDepth) {
+		setError("Sections and partials nested deeper than " + std::to_string(m_limits.maxDepth) + " levels",
+		         pos);
+		return false;
+	}
+	++m_nesting;
+	return true;
+}
+
+bool Renderer::withinLimits(int pos, const std::string& output)
+{
+	if (m_limits.maxOutputSize > 0 && m_priorOutput + output.size() > m_limits.maxOutputSize) {
+		setError("Output larger than " + std::to_string(m_limits.maxOutputSize) + " bytes", pos);
+		return false;
+	}
+	// Reading the clock for every node would be slow, so check every so often.
+	if (m_limits.timeBudget.count() > 0 && ++m_nodeCount % 256 == 0 &&
+	    std::chrono::steady_clock::now() > m_deadline) {
+		setError("Rendering took longer than " + std::to_string(m_limits.timeBudget.count()) + " ms", pos);
+		return false;
+	}
+	return true;
+}
+
+Template Renderer::compiled(std::unordered_map<std::string, Template>* cache, std::string_view source)
+{
+	std::string key(source);
+	auto it = cache->find(key);
+	if (it == cache->end()) {
+		it = cache->emplace(key, Template(key, m_defaultTagStartMarker, m_defaultTagEndMarker)).first;
+	}
+	return it->second;
+}
+
+void Renderer::setError(const std::string& error, int pos)
+{
+	assert(!error.empty());
+	assert(pos >= 0);
+
+	m_error = error;
+	m_errorPos = pos;
+
+	if (!m_partialStack.empty())
+	{
+		m_errorPartial = m_partialStack.back();
+	}
+}
+
+void Renderer::setTagMarkers(std::string_view startMarker, std::string_view endMarker)
+{
+	m_defaultTagStartMarker = startMarker;
+	m_defaultTagEndMarker = endMarker;
+}
+
+void Renderer::setLimits(const RenderLimits& limits)
+{
+	m_limits = limits;
+}
+
+void Renderer::continueDocument(size_t written, std::chrono::steady_clock::time_point deadline)
+{
+	m_continued = true;
+	m_priorOutput = written;
+	m_deadline = deadline;
+}
+
+std::chrono::steady_clock::time_point Renderer::deadline() const
+{
+	if (m_limits.timeBudget.count() <= 0) {
+		return std::chrono::steady_clock::time_point::max();
+	}
+	return m_deadline;
+}
+
+void Renderer::setMemoization(bool enabled)
+{
+	m_memoization = enabled;
+}
+
+void Renderer::setEvalError(const std::string& error)
+{
+	if (m_errorPos == -1) {
+		setError(error, m_evalPos);
+	}
+}
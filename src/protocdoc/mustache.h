@@ -0,0 +1,592 @@
+/*
+  Copyright 2012, Robert Knight
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace Mustache
+{
+
+class Context;
+class PartialResolver;
+class Renderer;
+
+/** A value in a template model.
+  *
+  * Text is held as UTF-8. A string value either owns its text, or is a view of
+  * text owned by someone else (e.g. a descriptor name), see view().
+  */
+class Value
+{
+public:
+	enum Type
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		List,
+		Map,
+		Function
+	};
+
+	typedef std::function<std::string(std::string_view, Mustache::Renderer*, Mustache::Context*)> fn_t;
+	typedef std::vector<Value> list_t;
+	typedef std::vector<std::pair<std::string, Value>> map_t;
+
+	Value();
+	Value(bool value);
+	Value(int value);
+	Value(long long value);
+	Value(const char* text);
+	Value(std::string text);
+	Value(list_t list);
+	Value(map_t map);
+	Value(fn_t fn);
+
+	/** Returns a string value which refers to @p text without copying it.
+	  * The text must outlive the returned value and any copies of it.
+	  */
+	static Value view(std::string_view text);
+
+	Type type() const;
+	bool isNull() const;
+
+	bool toBool() const;
+	long long toNumber() const;
+
+	/** Returns the text of a string value, or an empty view for other types. */
+	std::string_view text() const;
+
+	const list_t& list() const;
+	const map_t& map() const;
+	const fn_t& function() const;
+
+	/** Returns the value for @p key in a map value, or nullptr if there is none. */
+	const Value* find(std::string_view key) const;
+
+	/** Returns the value for @p key in a map value, inserting a null value if
+	  * there is none. A null value is turned into an empty map first.
+	  */
+	Value& operator[](std::string_view key);
+
+	/** Appends @p value to a list value. A null value is turned into an empty list first. */
+	void append(Value value);
+
+	/** Returns the number of items in a list or map value, otherwise 0. */
+	size_t size() const;
+	bool isEmpty() const;
+
+private:
+	std::variant<std::monostate, bool, long long, std::string, std::string_view, list_t, map_t, fn_t> m_data;
+};
+
+/** Context is an interface that Mustache::Renderer::render() uses to
+  * fetch substitutions for template tags.
+  */
+class Context
+{
+public:
+	/** Create a context.  @p resolver is used to fetch the expansions for any {{>partial}} tags
+	  * which appear in a template.
+	  */
+	explicit Context(PartialResolver* resolver = 0);
+	virtual ~Context() {}
+
+	/** Returns a string representation of the value for @p key in the current context.
+	  * This is used to replace a Mustache value tag.
+	  *
+	  * The returned view is valid until the next call on the context.
+	  */
+	virtual std::string_view stringValue(std::string_view key) const = 0;
+
+	/** Returns true if the value for @p key is 'false' or an empty list.
+	  * 'False' values typically include empty strings, the boolean value false etc.
+	  *
+	  * When processing a section Mustache tag, the section is not rendered if the key
+	  * is false, or for an inverted section tag, the section is only rendered if the key
+	  * is false.
+	  */
+	virtual bool isFalse(std::string_view key) const = 0;
+
+	/** Returns the number of items in the list value for @p key or 0 if
+	  * the value for @p key is not a list.
+	  */
+	virtual int listCount(std::string_view key) const = 0;
+
+	/** Set the current context to the value for @p key.
+	  * If index is >= 0, set the current context to the @p index'th value
+	  * in the list value for @p key.
+	  */
+	virtual void push(std::string_view key, int index = -1) = 0;
+
+	/** Exit the current context. */
+	virtual void pop() = 0;
+
+	/** Returns the partial template for a given @p key. */
+	std::string partialValue(std::string_view key) const;
+
+	/** Returns the partial resolver passed to the constructor. */
+	PartialResolver* partialResolver() const;
+
+	/** Returns true if eval() should be used to render section tags using @p key.
+	 * If canEval() returns true for a key, the renderer will pass the literal, unrendered
+	 * block of text for the section to eval() and replace the section with the result.
+	 *
+	 * canEval() and eval() are equivalents for callable objects (eg. lambdas) in other
+	 * Mustache implementations.
+	 *
+	 * The default implementation always returns false.
+	 */
+	virtual bool canEval(std::string_view key) const;
+
+	/** Callback used to render a template section with the given @p key.
+	 * @p renderer will substitute the original section tag with the result of eval().
+	 *
+	 * The default implementation returns an empty string.
+	 */
+	virtual std::string eval(std::string_view key, std::string_view _template, Renderer* renderer);
+
+	/** Appends a fingerprint of the value for @p key in the current context to @p out.
+	  * Values with equal fingerprints must render identically, this is used to
+	  * memoize the output of sections, see Node::memoizable. Lambdas are assumed
+	  * to depend only on the section body and the context they are given.
+	  *
+	  * The default implementation returns false, which means that the value
+	  * cannot be fingerprinted and sections using it are always rendered.
+	  */
+	virtual bool fingerprint(std::string_view key, std::string* out) const;
+
+private:
+	PartialResolver* m_partialResolver;
+};
+
+/** A context implementation which wraps a Mustache::Value. */
+class ValueContext : public Context
+{
+public:
+	/** Construct a ValueContext which wraps the map value @p root.
+	 * @p root must outlive the context.
+	 */
+	explicit ValueContext(const Value& root, PartialResolver* resolver = 0);
+
+	virtual std::string_view stringValue(std::string_view key) const;
+	virtual bool isFalse(std::string_view key) const;
+	virtual int listCount(std::string_view key) const;
+	virtual void push(std::string_view key, int index = -1);
+	virtual void pop();
+	virtual bool canEval(std::string_view key) const;
+	virtual std::string eval(std::string_view key, std::string_view _template, Mustache::Renderer* renderer);
+	virtual bool fingerprint(std::string_view key, std::string* out) const;
+
+private:
+	const Value* value(std::string_view key) const;
+
+	std::vector<const Value*> m_contextStack;
+	mutable std::string m_number;
+};
+
+/** Interface for fetching template partials. */
+class PartialResolver
+{
+public:
+	virtual ~PartialResolver() {}
+
+	/** Returns the partial template with a given @p name. */
+	virtual std::string getPartial(std::string_view name) = 0;
+};
+
+/** A simple partial fetcher which returns templates from a map of (partial name -> template)
+  */
+class PartialMap : public PartialResolver
+{
+public:
+	explicit PartialMap(const std::unordered_map<std::string, std::string>& partials);
+
+	virtual std::string getPartial(std::string_view name);
+
+private:
+	std::unordered_map<std::string, std::string> m_partials;
+};
+
+/** A partial fetcher when loads templates from '<name>.mustache' files
+ * in a given directory.
+ *
+ * Once a partial has been loaded, it is cached for future use.
+ */
+class PartialFileLoader : public PartialResolver
+{
+public:
+	explicit PartialFileLoader(const std::string& basePath);
+
+	virtual std::string getPartial(std::string_view name);
+
+private:
+	std::string m_basePath;
+	std::unordered_map<std::string, std::string> m_cache;
+};
+
+/** Holds properties of a tag in a mustache template. */
+struct Tag
+{
+	enum Type
+	{
+		Null,
+		Value, /// A {{key}} or {{{key}}} tag
+		SectionStart, /// A {{#section}} tag
+		InvertedSectionStart, /// An {{^inverted-section}} tag
+		SectionEnd, /// A {{/section}} tag
+		Partial, /// A {{^partial}} tag
+		Comment, /// A {{! comment }} tag
+		SetDelimiter /// A {{=<% %>=}} tag
+	};
+
+	enum EscapeMode
+	{
+		Escape,
+		Unescape,
+		Raw
+	};
+
+	Tag()
+		: type(Null)
+		, start(0)
+		, end(0)
+		, escapeMode(Escape)
+	{}
+
+	Type type;
+	std::string_view key;
+	int start;
+	int end;
+	EscapeMode escapeMode;
+};
+
+/** A node in a compiled template.
+  *
+  * The text of a node refers to the source of the Template that owns it.
+  */
+struct Node
+{
+	enum Type
+	{
+		Text, /// Literal template text
+		Value, /// A {{key}} or {{{key}}} tag
+		Section, /// A {{#section}}...{{/section}} block
+		InvertedSection, /// An {{^inverted-section}}...{{/inverted-section}} block
+		Partial /// A {{>partial}} tag
+	};
+
+	Node()
+		: type(Text)
+		, pos(0)
+		, escapeMode(Tag::Escape)
+		, memoizable(false)
+	{}
+
+	Type type;
+	std::string_view text; /// Literal text, or the key for all other node types
+	int pos; /// Position of the node in the template source
+	Tag::EscapeMode escapeMode;
+	std::string_view source; /// Literal, unrendered body of a section, for Context::eval()
+	std::vector<Node> children; /// Body of a section
+
+	/** True if the output of a section depends only on the values of memoKeys,
+	  * so that Renderer may reuse it when they are the same. Sections containing
+	  * partials are never memoizable, as their content is not known when compiling.
+	  */
+	bool memoizable;
+	std::vector<std::string_view> memoKeys; /// Keys used by a section and its body
+};
+
+/** Functions of Renderer called by a template translated to C++, see RenderFunction.
+  *
+  * They stand in for what Renderer does while rendering the nodes of a template,
+  * so that a template module only depends on the virtual functions of Context
+  * and the render limits apply as usual. All but leave() return false if the
+  * render should stop, in which case the module returns right away.
+  */
+struct RenderHooks
+{
+	/** Renders the partial @p name, whose tag is at @p pos in the template source. */
+	bool (*renderPartial)(Renderer* renderer, std::string_view name, int pos, Context* context,
+	                      std::string* output);
+
+	/** Enters the section at @p pos, checking the nesting depth. Unless this
+	  * returns false, leave() must be called once the section is rendered.
+	  */
+	bool (*enter)(Renderer* renderer, int pos);
+
+	/** Leaves the section entered last. */
+	void (*leave)(Renderer* renderer);
+
+	/** Appends the output of the lambda section @p key at @p pos, whose
+	  * unrendered body is @p body, as Context::eval() returns it.
+	  */
+	bool (*eval)(Renderer* renderer, std::string_view key, std::string_view body, int pos, Context* context,
+	             std::string* output);
+
+	/** Checks the output size and time taken against the limits after the node
+	  * at @p pos was rendered into @p output.
+	  */
+	bool (*withinLimits)(Renderer* renderer, int pos, const std::string& output);
+};
+
+/** Renders a template translated to C++, see protocdoc::compiledTemplateModule().
+  *
+  * The function renders the template with @p context into @p output, the same way
+  * Renderer would render the template source, calling @p hooks where Renderer
+  * would check its limits or render a partial or lambda.
+  */
+typedef void (*RenderFunction)(Context* context, Renderer* renderer, const RenderHooks* hooks,
+                               std::string* output);
+
+/** A compiled Mustache template.
+  *
+  * A Template is immutable once constructed, and may be shared between any number
+  * of Renderer instances, including ones running concurrently in different threads.
+  * Copying a Template is cheap, copies share the compiled nodes.
+  */
+class Template
+{
+public:
+	/** Create an empty template. */
+	Template();
+
+	/** Compile @p source, using @p startMarker and @p endMarker as the initial
+	  * tag markers. Use isValid() to check if compilation succeeded.
+	  */
+	explicit Template(std::string source,
+	                  std::string_view startMarker = "{{",
+	                  std::string_view endMarker = "}}");
+
+	/** Compile @p source, which @p function renders as a whole.
+	  *
+	  * Renderer::render() calls @p function instead of rendering the nodes, which
+	  * are still available for inspecting the template.
+	  */
+	Template(std::string source, RenderFunction function);
+
+	/** Returns true if the template was compiled without errors. */
+	bool isValid() const;
+
+	/** Returns a message describing the compilation error, or an empty string. */
+	std::string error() const;
+
+	/** Returns the position in the source where compilation failed, or -1. */
+	int errorPos() const;
+
+	/** Returns the source the template was compiled from. */
+	std::string_view source() const;
+
+	/** Returns the top-level nodes of the compiled template. */
+	const std::vector<Node>& nodes() const;
+
+	/** Returns the function rendering the template, or null if there is none. */
+	RenderFunction renderFunction() const;
+
+private:
+	struct Data
+	{
+		std::string source;
+		std::vector<Node> nodes;
+		std::string error;
+		int errorPos;
+		RenderFunction function = nullptr;
+	};
+
+	static std::shared_ptr<const Data> compiled(std::string source, std::string_view startMarker,
+	                                            std::string_view endMarker, RenderFunction function);
+
+	std::shared_ptr<const Data> d;
+};
+
+/** Limits on the resources used by a render, see Renderer::setLimits().
+  *
+  * A render exceeding a limit stops with an error at the position of the tag
+  * being rendered, rather than overflowing the stack or exhausting memory.
+  */
+struct RenderLimits
+{
+	/** Maximum nesting depth of sections, partials and lambdas, or 0 for no limit.
+	  * The default is generous for any sensible template, but stops partials that
+	  * include themselves long before the stack overflows.
+	  */
+	int maxDepth = 256;
+
+	/** Maximum size of the output of a render() call in bytes, or 0 for no limit. */
+	size_t maxOutputSize = 0;
+
+	/** Maximum wall-clock time of a render() call, or 0 for no limit. */
+	std::chrono::milliseconds timeBudget = std::chrono::milliseconds(0);
+};
+
+/** Renders Mustache templates, replacing mustache tags with
+  * values from a provided context.
+  *
+  * A Renderer is a render session: it holds the state of a single render() call
+  * (partial stack, compiled partials, errors), so create one per call or per thread.
+  * The compiled Template it renders is never modified.
+  */
+class Renderer
+{
+public:
+	Renderer();
+
+	/** Render a Mustache template, using @p context to fetch
+	  * the values used to replace Mustache tags.
+	  *
+	  * When called from Context::eval() during another render, @p _template
+	  * is rendered as part of that render and errors are reported through it.
+	  */
+	std::string render(std::string_view _template, Context* context);
+
+	/** Render the compiled template @p _template, using @p context to fetch
+	  * the values used to replace Mustache tags.
+	  */
+	std::string render(const Template& _template, Context* context);
+
+	/** Render the nodes @p nodes of the compiled template @p _template, appending
+	  * the result to @p output.
+	  *
+	  * This renders a template piece by piece, for example one item of a top-level
+	  * section at a time. Errors are reported as for render().
+	  */
+	void render(const Template& _template, const std::vector<Node>& nodes, Context* context, std::string* output);
+
+	/** Returns a message describing the last error encountered by the previous
+	  * render() call.
+	  */
+	std::string error() const;
+
+	/** Returns the position in the template where the last error occurred
+	  * when rendering the template or -1 if no error occurred.
+	  *
+	  * If the error occurred in a partial template, the returned position is the offset
+	  * in the partial template.
+	  */
+	int errorPos() const;
+
+	/** Returns the name of the partial where the error occurred, or an empty string
+	 * if the error occurred in the main template.
+	 */
+	std::string errorPartial() const;
+
+	/** Sets the default tag start and end markers.
+	  * This can be overridden within a template.
+	  */
+	void setTagMarkers(std::string_view startMarker, std::string_view endMarker);
+
+	/** Sets the limits on the resources used by each render() call. */
+	void setLimits(const RenderLimits& limits);
+
+	/** Makes the limits apply to a whole document rendered piece by piece with
+	  * several render() calls, rather than to each call. Until the next call,
+	  * @p written bytes are counted as output already, and rendering stops at
+	  * @p deadline rather than RenderLimits::timeBudget after the call starts.
+	  */
+	void continueDocument(size_t written, std::chrono::steady_clock::time_point deadline);
+
+	/** Returns the time at which the current render() call stops with an error,
+	  * or time_point::max() if it has no time budget. Lambdas which may run for
+	  * long, such as Lua filters, check it themselves.
+	  */
+	std::chrono::steady_clock::time_point deadline() const;
+
+	/** Enables or disables memoization of sections, which is disabled by default.
+	  *
+	  * While memoization is enabled, the output of a memoizable section is kept
+	  * for the duration of a render() call, keyed by the fingerprints of the
+	  * values it uses (see Context::fingerprint()), and copied the next time the
+	  * section is rendered with the same values. Lambda sections are not
+	  * memoized, since they render their body in the enclosing context. Sections
+	  * which never repeat stop being memoized after a few renders. This pays off
+	  * for templates whose sections render the same output many times, e.g. for
+	  * repeated field types.
+	  */
+	void setMemoization(bool enabled);
+
+	/** Reports an error from a lambda called through Context::eval(), which
+	  * stops the render. The error is located at the tag of the evaluated section.
+	  */
+	void setEvalError(const std::string& error);
+
+private:
+	void start();
+	void render(const std::vector<Node>& nodes, Context* context, std::string* output);
+	void renderSection(const Node& node, Context* context, std::string* output);
+	void renderPartial(std::string_view name, int pos, Context* context, std::string* output);
+	void eval(std::string_view key, std::string_view body, int pos, Context* context, std::string* output);
+	bool enter(int pos);
+	bool withinLimits(int pos, const std::string& output);
+
+	static const RenderHooks s_hooks;
+	static bool renderPartialHook(Renderer* renderer, std::string_view name, int pos, Context* context,
+	                              std::string* output);
+	static bool enterHook(Renderer* renderer, int pos);
+	static void leaveHook(Renderer* renderer);
+	static bool evalHook(Renderer* renderer, std::string_view key, std::string_view body, int pos,
+	                     Context* context, std::string* output);
+	static bool withinLimitsHook(Renderer* renderer, int pos, const std::string& output);
+	Template compiled(std::unordered_map<std::string, Template>* cache, std::string_view source);
+	void setError(const std::string& error, int pos);
+
+	int m_depth;
+	std::vector<std::string> m_partialStack;
+	std::unordered_map<std::string, Template> m_partials;
+	std::unordered_map<std::string, Template> m_sections;
+	std::string m_error;
+	int m_errorPos;
+	std::string m_errorPartial;
+
+	RenderLimits m_limits;
+	int m_evalPos;
+	int m_nesting;
+	unsigned m_nodeCount;
+	std::chrono::steady_clock::time_point m_deadline;
+	bool m_continued;      /**< Set by continueDocument() for the next render() call. */
+	size_t m_priorOutput;  /**< Output written before the render() call. */
+
+	/** Rendered outputs of a memoizable section, keyed by fingerprint. */
+	struct Memo
+	{
+		std::unordered_map<std::string, std::string> outputs;
+		int renders = 0;
+		int hits = 0;
+		int misses = 0;
+		bool disabled = false;
+	};
+
+	bool m_memoization;
+	std::unordered_map<const Node*, Memo> m_memos;
+	size_t m_memoSize;
+
+	std::string m_defaultTagStartMarker;
+	std::string m_defaultTagEndMarker;
+};
+
+/** A convenience function which renders a template using the given data. */
+std::string renderTemplate(std::string_view templateString, const Value& args);
+
+};
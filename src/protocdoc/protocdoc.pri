@@ -0,0 +1,33 @@
+# The protocdoc library: documentation model extraction and Mustache engine.
+# Depends only on the C++ standard library and libprotobuf.
+
+HEADERS += \
+    $$PWD/filters.h \
+    $$PWD/json.h \
+    $$PWD/manifest.h \
+    $$PWD/markup.h \
+    $$PWD/model.h \
+    $$PWD/mustache.h \
+    $$PWD/searchindex.h \
+    $$PWD/selection.h \
+    $$PWD/templateanalyzer.h \
+    $$PWD/templatecompiler.h \
+    $$PWD/templatemodule.h
+
+SOURCES += \
+    $$PWD/filters.cpp \
+    $$PWD/json.cpp \
+    $$PWD/manifest.cpp \
+    $$PWD/markup.cpp \
+    $$PWD/model.cpp \
+    $$PWD/mustache.cpp \
+    $$PWD/searchindex.cpp \
+    $$PWD/selection.cpp \
+    $$PWD/templateanalyzer.cpp \
+    $$PWD/templatecompiler.cpp
+
+# Optional adapter for rendering models held in QVariants.
+qt {
+    HEADERS += $$PWD/qtvariantcontext.h
+    SOURCES += $$PWD/qtvariantcontext.cpp
+}
@@ -0,0 +1,32 @@
+# Builds the protocdoc library on its own, without Qt, for embedding the
+# documentation generator into other tools. Link the result together with
+# libprotobuf.
+
+TEMPLATE = lib
+TARGET = protocdoc
+VERSION = 0.9
+
+CONFIG += staticlib c++17
+CONFIG -= qt
+
+include(protocdoc.pri)
+
+linux {
+    # Use pkg-config to find libprotobuf.
+    CONFIG += link_pkgconfig
+    PKGCONFIG = protobuf
+}
+
+msvc|mac {
+    # Get location of protobuf headers.
+    PROTOBUF_PREFIX = $$getenv(PROTOBUF_PREFIX)
+    isEmpty(PROTOBUF_PREFIX) {
+        error(You must set the PROTOBUF_PREFIX environment variable!)
+    }
+}
+
+msvc:INCLUDEPATH += "$${PROTOBUF_PREFIX}\src"
+mac:INCLUDEPATH += "$${PROTOBUF_PREFIX}/include"
+
+# Increase g++ warnings.
+*g++*:QMAKE_CXXFLAGS += -Werror -Wall -Wextra
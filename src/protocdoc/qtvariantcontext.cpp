@@ -0,0 +1,196 @@
+/*
+  Copyright 2012, Robert Knight
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "qtvariantcontext.h"
+
+#include <QtCore/QStringList>
+
+using namespace Mustache;
+
+QtVariantContext::QtVariantContext(const QVariant& root, PartialResolver* resolver)
+	: Context(resolver)
+{
+	m_contextStack << root;
+}
+
+QVariant variantMapValue(const QVariant& value, const QString& key)
+{
+	if (value.userType() == QVariant::Map) {
+		return value.toMap().value(key);
+	} else {
+		return value.toHash().value(key);
+	}
+}
+
+QVariant variantMapValueForKeyPath(const QVariant& value, const QStringList keyPath)
+{
+	if (keyPath.count() > 1) {
+		QVariant firstValue = variantMapValue(value, keyPath.first());
+		return firstValue.isNull() ? QVariant() : variantMapValueForKeyPath(firstValue, keyPath.mid(1));
+	} else if (!keyPath.isEmpty()) {
+		return variantMapValue(value, keyPath.first());
+	}
+	return QVariant();
+}
+
+QVariant QtVariantContext::value(std::string_view key) const
+{
+	if (key == "." && !m_contextStack.isEmpty()) {
+		return m_contextStack.last();
+	}
+	QStringList keyPath = QString::fromUtf8(key.data(), static_cast<int>(key.size())).split(".");
+	for (int i = m_contextStack.count()-1; i >= 0; i--) {
+		QVariant value = variantMapValueForKeyPath(m_contextStack.at(i), keyPath);
+		if (!value.isNull()) {
+			return value;
+		}
+	}
+	return QVariant();
+}
+
+bool QtVariantContext::isFalse(std::string_view key) const
+{
+	QVariant value = this->value(key);
+	switch (value.userType()) {
+	case QVariant::Bool:
+		return !value.toBool();
+	case QVariant::List:
+		return value.toList().isEmpty();
+	case QVariant::Hash:
+		return value.toHash().isEmpty();
+	case QVariant::Map:
+		return value.toMap().isEmpty();
+	default:
+		return value.toString().isEmpty();
+	}
+}
+
+std::string_view QtVariantContext::stringValue(std::string_view key) const
+{
+	if (isFalse(key)) {
+		return std::string_view();
+	}
+	QVariant value = this->value(key);
+	m_value = value.userType() == QVariant::ByteArray ? value.toByteArray() : value.toString().toUtf8();
+	return std::string_view(m_value.constData(), m_value.size());
+}
+
+void QtVariantContext::push(std::string_view key, int index)
+{
+	QVariant mapItem = value(key);
+	if (index == -1) {
+		m_contextStack << mapItem;
+	} else {
+		QVariantList list = mapItem.toList();
+		m_contextStack << list.value(index, QVariant());
+	}
+}
+
+void QtVariantContext::pop()
+{
+	m_contextStack.pop();
+}
+
+int QtVariantContext::listCount(std::string_view key) const
+{
+	if (value(key).userType() == QVariant::List) {
+		return value(key).toList().count();
+	}
+	return 0;
+}
+
+bool QtVariantContext::canEval(std::string_view key) const
+{
+	return value(key).canConvert<fn_t>();
+}
+
+std::string QtVariantContext::eval(std::string_view key, std::string_view _template, Renderer* renderer)
+{
+	QVariant fn = value(key);
+	if (fn.isNull()) {
+		return std::string();
+	}
+	return fn.value<fn_t>()(_template, renderer, this);
+}
+
+QVariant Mustache::toVariant(const Value& value)
+{
+	switch (value.type()) {
+	case Value::Bool:
+		return QVariant(value.toBool());
+	case Value::Number:
+		return QVariant(value.toNumber());
+	case Value::String:
+		return QString::fromUtf8(value.text().data(), static_cast<int>(value.text().size()));
+	case Value::List:
+	{
+		QVariantList list;
+		for (const Value& item : value.list()) {
+			list.append(toVariant(item));
+		}
+		return list;
+	}
+	case Value::Map:
+	{
+		QVariantHash hash;
+		for (const auto& entry : value.map()) {
+			hash.insert(QString::fromStdString(entry.first), toVariant(entry.second));
+		}
+		return hash;
+	}
+	case Value::Function:
+		return QVariant::fromValue(value.function());
+	default:
+		return QVariant();
+	}
+}
+
+Value Mustache::fromVariant(const QVariant& variant)
+{
+	switch (variant.userType()) {
+	case QVariant::Invalid:
+		return Value();
+	case QVariant::Bool:
+		return Value(variant.toBool());
+	case QVariant::Int:
+	case QVariant::UInt:
+	case QVariant::LongLong:
+	case QVariant::ULongLong:
+		return Value(variant.toLongLong());
+	case QVariant::List:
+	case QVariant::StringList:
+	{
+		Value list{Value::list_t()};
+		for (const QVariant& item : variant.toList()) {
+			list.append(fromVariant(item));
+		}
+		return list;
+	}
+	case QVariant::Map:
+	case QVariant::Hash:
+	{
+		Value map{Value::map_t()};
+		const QVariantHash hash = variant.toHash();
+		for (QVariantHash::const_iterator it = hash.begin(); it != hash.end(); ++it) {
+			map[it.key().toStdString()] = fromVariant(it.value());
+		}
+		return map;
+	}
+	default:
+		if (variant.canConvert<Value::fn_t>()) {
+			return Value(variant.value<Value::fn_t>());
+		}
+		return Value(variant.toString().toStdString());
+	}
+}
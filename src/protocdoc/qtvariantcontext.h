@@ -0,0 +1,66 @@
+/*
+  Copyright 2012, Robert Knight
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "mustache.h"
+
+#include <QtCore/QStack>
+#include <QtCore/QVariant>
+
+namespace Mustache
+{
+
+/** A context implementation which wraps a QVariantHash or QVariantMap.
+ *
+ * Values are converted to UTF-8 as they are looked up. Prefer ValueContext
+ * unless the model is already held in QVariants.
+ */
+class QtVariantContext : public Context
+{
+public:
+	/** Construct a QtVariantContext which wraps a dictionary in a QVariantHash
+	 * or a QVariantMap.
+	 */
+	typedef Value::fn_t fn_t;
+	explicit QtVariantContext(const QVariant& root, PartialResolver* resolver = 0);
+
+	virtual std::string_view stringValue(std::string_view key) const;
+	virtual bool isFalse(std::string_view key) const;
+	virtual int listCount(std::string_view key) const;
+	virtual void push(std::string_view key, int index = -1);
+	virtual void pop();
+	virtual bool canEval(std::string_view key) const;
+	virtual std::string eval(std::string_view key, std::string_view _template, Mustache::Renderer* renderer);
+
+private:
+	QVariant value(std::string_view key) const;
+
+	QStack<QVariant> m_contextStack;
+	mutable QByteArray m_value;
+};
+
+/** Converts @p value to a QVariant, e.g. for use with QtVariantContext.
+ * Function values are kept as QtVariantContext::fn_t, which QtVariantContext
+ * calls as lambdas and fromVariant() converts back. QJsonDocument::fromVariant()
+ * can't represent them and writes null instead.
+ */
+QVariant toVariant(const Value& value);
+
+/** Converts the QVariant @p variant to a Value. Strings are copied to UTF-8. */
+Value fromVariant(const QVariant& variant);
+
+};
+
+Q_DECLARE_METATYPE(Mustache::QtVariantContext::fn_t)
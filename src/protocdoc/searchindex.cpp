@@ -0,0 +1,203 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "searchindex.h"
+
+#include "json.h"
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <string_view>
+#include <vector>
+
+namespace ms = Mustache;
+
+namespace protocdoc {
+
+/**
+ * Builder of the search index, see searchIndex().
+ */
+class SearchIndexBuilder {
+public:
+    /// Adds an entry labeled @p label of kind @p kind, documented under @p anchor.
+    void add(const std::string &label, const char *kind, std::string_view anchor)
+    {
+        const int entry = static_cast<int>(m_entries.size());
+        m_entries.push_back(ms::Value::list_t{ ms::Value(label), ms::Value(kind), ms::Value(std::string(anchor)) });
+
+        // Split into identifiers at punctuation other than underscores.
+        auto isIdentifier = [](char ch) { return std::isalnum(static_cast<unsigned char>(ch)) || ch == '_'; };
+        size_t pos = 0;
+        while (pos < label.size()) {
+            while (pos < label.size() && !isIdentifier(label[pos])) {
+                ++pos;
+            }
+            const size_t start = pos;
+            while (pos < label.size() && isIdentifier(label[pos])) {
+                ++pos;
+            }
+            addIdentifier(std::string_view(label).substr(start, pos - start), entry);
+        }
+    }
+
+    /// Returns the index, see searchIndex().
+    ms::Value index() const
+    {
+        ms::Value::list_t tokens;
+        ms::Value::list_t postings;
+        for (const auto &token : m_tokens) {
+            tokens.push_back(token.first);
+            ms::Value::list_t entries;
+            for (int entry : token.second) {
+                entries.push_back(entry);
+            }
+            postings.push_back(std::move(entries));
+        }
+
+        ms::Value index;
+        index["entries"] = m_entries;
+        index["postings"] = std::move(postings);
+        index["tokens"] = std::move(tokens);
+        return index;
+    }
+
+private:
+    /// Adds the words of a snake_case @p identifier, and the words joined.
+    void addIdentifier(std::string_view identifier, int entry)
+    {
+        std::string joined;
+        int words = 0;
+        size_t start = 0;
+        while (start <= identifier.size()) {
+            const size_t end = std::min(identifier.find('_', start), identifier.size());
+            const std::string_view word = identifier.substr(start, end - start);
+            if (!word.empty()) {
+                addWord(word, entry);
+                joined += word;
+                ++words;
+            }
+            start = end + 1;
+        }
+        if (words > 1) {
+            addToken(joined, entry);
+        }
+    }
+
+    void addWord(std::string_view word, int entry)
+    {
+        if (word.empty()) {
+            return;
+        }
+        int parts = 0;
+        size_t start = 0;
+        for (size_t i = 1; i <= word.size(); ++i) {
+            const bool end = i == word.size() ||
+                    (std::islower(static_cast<unsigned char>(word[i - 1])) && std::isupper(static_cast<unsigned char>(word[i]))) ||
+                    (i + 1 < word.size() && std::isupper(static_cast<unsigned char>(word[i - 1])) &&
+                     std::isupper(static_cast<unsigned char>(word[i])) && std::islower(static_cast<unsigned char>(word[i + 1])));
+            if (end) {
+                addToken(word.substr(start, i - start), entry);
+                start = i;
+                ++parts;
+            }
+        }
+        if (parts > 1) {
+            addToken(word, entry);
+        }
+    }
+
+    void addToken(std::string_view text, int entry)
+    {
+        std::string token(text);
+        for (char &ch : token) {
+            ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+        }
+        std::vector<int> &entries = m_tokens[token];
+        if (entries.empty() || entries.back() != entry) {
+            entries.push_back(entry);
+        }
+    }
+
+    ms::Value::list_t m_entries;
+    std::map<std::string, std::vector<int>> m_tokens;
+};
+
+/**
+ * Returns the text of the string value for @p key in the map value @p value.
+ */
+static std::string textOf(const ms::Value &value, std::string_view key)
+{
+    const ms::Value *item = value.find(key);
+    return item ? std::string(item->text()) : std::string();
+}
+
+/**
+ * Returns the list value for @p key in the map value @p value.
+ */
+static const ms::Value::list_t &listOf(const ms::Value &value, std::string_view key)
+{
+    static const ms::Value::list_t empty;
+    const ms::Value *item = value.find(key);
+    return item && item->type() == ms::Value::List ? item->list() : empty;
+}
+
+std::string searchIndex(const ms::Value &files)
+{
+    SearchIndexBuilder builder;
+
+    // The anchors are those of the html template.
+    for (const ms::Value &file : files.list()) {
+        const std::string fileName = textOf(file, "file_name");
+        builder.add(fileName, "file", fileName);
+
+        for (const ms::Value &message : listOf(file, "file_messages")) {
+            const std::string name = textOf(message, "message_long_name");
+            const std::string anchor = textOf(message, "message_full_name");
+            builder.add(name, "message", anchor);
+            for (const ms::Value &field : listOf(message, "message_fields")) {
+                builder.add(name + "." + textOf(field, "field_name"), "field", anchor);
+            }
+            for (const ms::Value &extension : listOf(message, "message_extensions")) {
+                builder.add(textOf(extension, "extension_long_name"), "extension", anchor);
+            }
+        }
+
+        for (const ms::Value &enum_ : listOf(file, "file_enums")) {
+            const std::string name = textOf(enum_, "enum_long_name");
+            const std::string anchor = textOf(enum_, "enum_full_name");
+            builder.add(name, "enum", anchor);
+            for (const ms::Value &value : listOf(enum_, "enum_values")) {
+                builder.add(name + "." + textOf(value, "value_name"), "value", anchor);
+            }
+        }
+
+        for (const ms::Value &extension : listOf(file, "file_extensions")) {
+            builder.add(textOf(extension, "extension_long_name"), "extension", fileName + "-extensions");
+        }
+
+        for (const ms::Value &service : listOf(file, "file_services")) {
+            const std::string name = textOf(service, "service_name");
+            const std::string anchor = textOf(service, "service_full_name");
+            builder.add(name, "service", anchor);
+            for (const ms::Value &method : listOf(service, "service_methods")) {
+                builder.add(name + "." + textOf(method, "method_name"), "method", anchor);
+            }
+        }
+    }
+
+    return toJson(builder.index(), Compact);
+}
+
+} // namespace protocdoc
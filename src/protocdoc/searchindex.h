@@ -0,0 +1,42 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "mustache.h"
+
+#include <string>
+
+namespace protocdoc {
+
+/**
+ * Returns a search index for the list of extracted files @p files.
+ *
+ * The index maps lowercase name tokens of the files, messages, fields, enums,
+ * enum values, extensions, services and methods in @p files to the HTML anchors
+ * they are documented under. Names are split into tokens at punctuation and at
+ * camel case boundaries, and the parts of camel and snake case words are also
+ * joined, so "BookingStatus.vehicle_id" yields "booking", "status",
+ * "bookingstatus", "vehicle", "id" and "vehicleid".
+ *
+ * The index is compact JSON of the form
+ *
+ *     {"entries":[[LABEL,KIND,ANCHOR],...],"postings":[[ENTRY,...],...],"tokens":[TOKEN,...]}
+ *
+ * where the tokens are sorted, so that a client can look up tokens by prefix
+ * with a binary search, and postings[i] lists the entries holding tokens[i].
+ */
+std::string searchIndex(const Mustache::Value &files);
+
+} // namespace protocdoc
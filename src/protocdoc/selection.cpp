@@ -0,0 +1,149 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "selection.h"
+
+#include <google/protobuf/descriptor.h>
+
+namespace gp = google::protobuf;
+
+namespace protocdoc {
+
+/**
+ * Returns true if the glob @p glob matches all of @p text.
+ */
+static bool globMatches(std::string_view glob, std::string_view text)
+{
+    // Match greedily, and on a mismatch let the last '*' take one more character.
+    size_t g = 0;
+    size_t t = 0;
+    size_t star = std::string_view::npos;
+    size_t starText = 0;
+    while (t < text.size()) {
+        if (g < glob.size() && (glob[g] == '?' || glob[g] == text[t])) {
+            ++g;
+            ++t;
+        } else if (g < glob.size() && glob[g] == '*') {
+            star = g++;
+            starText = t;
+        } else if (star != std::string_view::npos) {
+            g = star + 1;
+            t = ++starText;
+        } else {
+            return false;
+        }
+    }
+    while (g < glob.size() && glob[g] == '*') {
+        ++g;
+    }
+    return g == glob.size();
+}
+
+bool Selection::addRule(bool include, const std::string &rule, std::string *error)
+{
+    Rule added;
+    added.include = include;
+    added.source = rule;
+
+    // Kind and pattern are separated by '=', since protoc splits --doc_out at
+    // the first ':'.
+    const size_t equals = rule.find('=');
+    const std::string kind = rule.substr(0, equals);
+    const std::string pattern = equals == std::string::npos ? std::string() : rule.substr(equals + 1);
+    if (kind == "package") {
+        added.kind = Package;
+    } else if (kind == "file") {
+        added.kind = File;
+    } else if (kind == "name") {
+        added.kind = Name;
+    } else {
+        *error = rule + ": Expected package=GLOB, file=GLOB or name=REGEX";
+        return false;
+    }
+    if (pattern.empty()) {
+        *error = rule + ": Expected a pattern";
+        return false;
+    }
+
+    if (added.kind == Name) {
+        try {
+            added.regex = std::regex(pattern, std::regex::ECMAScript | std::regex::optimize);
+        } catch (const std::regex_error &e) {
+            *error = rule + ": Invalid regular expression: " + e.what();
+            return false;
+        }
+    } else {
+        added.glob = pattern;
+    }
+
+    m_rules.push_back(std::move(added));
+    return true;
+}
+
+/**
+ * Returns true if @p text, of the kind @p kind, is selected by the rules.
+ */
+bool Selection::selects(Kind kind, std::string_view text) const
+{
+    bool hasInclude = false;
+    bool included = false;
+    for (const Rule &rule : m_rules) {
+        if (rule.kind != kind) {
+            continue;
+        }
+        const bool matches = kind == Name
+                ? std::regex_match(text.begin(), text.end(), rule.regex)
+                : globMatches(rule.glob, text);
+        if (!rule.include && matches) {
+            return false;
+        }
+        hasInclude = hasInclude || rule.include;
+        included = included || (rule.include && matches);
+    }
+    return !hasInclude || included;
+}
+
+bool Selection::selectsFile(const gp::FileDescriptor *fileDescriptor) const
+{
+    return selects(Package, fileDescriptor->package()) && selects(File, fileDescriptor->name());
+}
+
+bool Selection::excludesName(std::string_view fullName) const
+{
+    for (const Rule &rule : m_rules) {
+        if (rule.kind == Name && !rule.include &&
+                std::regex_match(fullName.begin(), fullName.end(), rule.regex)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Selection::selectsName(std::string_view fullName) const
+{
+    return selects(Name, fullName);
+}
+
+std::string Selection::key() const
+{
+    std::string key;
+    for (const Rule &rule : m_rules) {
+        key += rule.include ? '+' : '-';
+        key += rule.source;
+        key += '\0';
+    }
+    return key;
+}
+
+} // namespace protocdoc
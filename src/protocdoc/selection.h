@@ -0,0 +1,91 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace google { namespace protobuf { class FileDescriptor; } }
+
+namespace protocdoc {
+
+/**
+ * Selection of the files and elements to document.
+ *
+ * A selection is made of include and exclude rules, each of which matches
+ * either the package of a file with a glob ("package=GLOB"), the path of a file
+ * with a glob ("file=GLOB") or the full name of a message, enum, service or
+ * extension with a regular expression ("name=REGEX"). In globs, '*' matches any
+ * sequence of characters, including '.' and '/', and '?' any single character.
+ * Globs and regular expressions must match the whole package, path or name.
+ *
+ * A file is selected if it matches none of the exclude rules for its kind and,
+ * if there are include rules for its kind, at least one of them. An element is
+ * documented if its full name matches none of the exclude name rules and, if
+ * there are include name rules, at least one of them. An element excluded by
+ * name is skipped together with the elements nested in it, while an element
+ * that is merely not included still has its nested elements considered.
+ * Members of an element, such as fields and methods, are documented with it.
+ *
+ * The rules are evaluated before a descriptor is visited, so nothing is
+ * extracted from a file or element that is not selected.
+ */
+class Selection
+{
+public:
+    /**
+     * Adds the rule @p rule, including if @p include is true and excluding
+     * otherwise. If the rule is invalid, @p error is set to point to an error
+     * message and false is returned.
+     */
+    bool addRule(bool include, const std::string &rule, std::string *error);
+
+    /// Returns true if there are no rules.
+    bool empty() const { return m_rules.empty(); }
+
+    /// Returns true if the file described by @p fileDescriptor is selected.
+    bool selectsFile(const google::protobuf::FileDescriptor *fileDescriptor) const;
+
+    /// Returns true if the element named @p fullName is excluded with its nested elements.
+    bool excludesName(std::string_view fullName) const;
+
+    /// Returns true if the element named @p fullName is documented.
+    bool selectsName(std::string_view fullName) const;
+
+    /**
+     * Returns a string identifying the rules, for use in cache keys. Two
+     * selections with the same rules in the same order have the same key.
+     */
+    std::string key() const;
+
+private:
+    enum Kind { Package, File, Name };
+
+    struct Rule {
+        bool include;       /**< Include rule, or exclude rule? */
+        Kind kind;          /**< What the rule matches. */
+        std::string source; /**< Rule as given. */
+        std::string glob;   /**< Pattern of Package and File rules. */
+        std::regex regex;   /**< Pattern of Name rules. */
+    };
+
+    bool selects(Kind kind, std::string_view text) const;
+
+    std::vector<Rule> m_rules;
+};
+
+} // namespace protocdoc
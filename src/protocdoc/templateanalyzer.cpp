@@ -0,0 +1,262 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "templateanalyzer.h"
+
+#include <cstdio>
+
+namespace ms = Mustache;
+
+namespace protocdoc {
+
+TextPosition textPosition(std::string_view source, int pos)
+{
+    TextPosition position = { 1, 1 };
+    for (int i = 0; i < pos && i < static_cast<int>(source.size()); ++i) {
+        if (source[i] == '\n') {
+            ++position.line;
+            position.column = 1;
+        } else {
+            ++position.column;
+        }
+    }
+    return position;
+}
+
+/**
+ * Returns @p count formatted with no decimals.
+ */
+static std::string formatCount(double count)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.0f", count);
+    return buffer;
+}
+
+TemplateAnalyzer::TemplateAnalyzer(const ms::Template &template_, const ms::Value &model)
+    : m_source(template_.source())
+    , m_tagCost(0)
+    , m_staticBytes(0)
+{
+    m_shapes.emplace_back();
+    merge(model, 0);
+
+    m_scopes.push_back(Scope{0, 1, false, "."});
+    walk(template_.nodes());
+}
+
+int TemplateAnalyzer::merge(const ms::Value &value, int shape)
+{
+    if (shape == -1) {
+        shape = static_cast<int>(m_shapes.size());
+        m_shapes.emplace_back();
+    }
+    ++m_shapes[shape].instances;
+
+    switch (value.type()) {
+    case ms::Value::List:
+        m_shapes[shape].list = true;
+        m_shapes[shape].items += value.size();
+        for (const ms::Value &item : value.list()) {
+            int element = merge(item, m_shapes[shape].element);
+            m_shapes[shape].element = element;
+        }
+        break;
+    case ms::Value::Map:
+        for (const auto &entry : value.map()) {
+            auto it = m_shapes[shape].keys.find(entry.first);
+            int child = merge(entry.second, it == m_shapes[shape].keys.end() ? -1 : it->second);
+            m_shapes[shape].keys[entry.first] = child;
+        }
+        break;
+    case ms::Value::Function:
+        m_shapes[shape].function = true;
+        break;
+    default:
+        break;
+    }
+
+    return shape;
+}
+
+int TemplateAnalyzer::resolve(std::string_view key, int *scopeIndex) const
+{
+    // Same lookup rules as Mustache::ValueContext.
+    for (int i = static_cast<int>(m_scopes.size()) - 1; i >= 0; --i) {
+        int shape = m_scopes[i].shape;
+        if (key == ".") {
+            *scopeIndex = i;
+            return shape;
+        }
+        std::string_view path = key;
+        while (shape != -1) {
+            size_t dot = path.find('.');
+            auto it = m_shapes[shape].keys.find(std::string(path.substr(0, dot)));
+            shape = it == m_shapes[shape].keys.end() ? -1 : it->second;
+            if (dot == std::string_view::npos) {
+                break;
+            }
+            path.remove_prefix(dot + 1);
+        }
+        if (shape != -1) {
+            *scopeIndex = i;
+            return shape;
+        }
+    }
+    return -1;
+}
+
+void TemplateAnalyzer::walk(const std::vector<ms::Node> &nodes)
+{
+    const Scope scope = m_scopes.back();
+
+    for (const ms::Node &node : nodes) {
+        if (node.type == ms::Node::Text) {
+            m_staticBytes += node.text.size() * scope.executions;
+            continue;
+        } else if (node.type == ms::Node::Partial) {
+            m_warnings.push_back(Message{node.pos,
+                    "partial '" + std::string(node.text) + "' is not analyzed"});
+            continue;
+        }
+
+        m_tagCost += scope.executions;
+
+        int scopeIndex = -1;
+        int shape = resolve(node.text, &scopeIndex);
+        if (shape == -1) {
+            m_unknownKeys.push_back(Message{node.pos, std::string(node.text)});
+        } else {
+            m_shapes[shape].used = true;
+        }
+
+        if (node.type == ms::Node::Value) {
+            continue;
+        }
+
+        if (node.type == ms::Node::Section && shape != -1 && m_shapes[shape].list) {
+            const Shape &list = m_shapes[shape];
+            double average = list.instances ? double(list.items) / list.instances : 0;
+            double executions = scope.executions * average;
+
+            int depth = 0;
+            for (const Scope &outer : m_scopes) {
+                depth += outer.iteration ? 1 : 0;
+            }
+            m_loops.push_back(Loop{node.pos, node.text, depth, executions});
+
+            // Iterating a list from an outer scope while inside an iteration
+            // over an inner list multiplies the cost of both.
+            for (size_t i = scopeIndex + 1; i < m_scopes.size(); ++i) {
+                if (m_scopes[i].iteration) {
+                    m_warnings.push_back(Message{node.pos,
+                            "'" + std::string(node.text) + "' is iterated inside '" +
+                            std::string(m_scopes[i].key) + "', cost grows with the product of their sizes"});
+                    break;
+                }
+            }
+
+            m_scopes.push_back(Scope{list.element, executions, true, node.text});
+        } else if (node.type == ms::Node::Section && shape != -1 && !m_shapes[shape].function) {
+            // Sections on maps and scalars push the value, so that {{.}} is the
+            // value itself and other keys are looked up in it first.
+            m_scopes.push_back(Scope{shape, scope.executions, false, node.text});
+        } else {
+            // Lambdas, inverted sections and sections on unknown keys render
+            // their body in the current scope.
+            walk(node.children);
+            continue;
+        }
+        walk(node.children);
+        m_scopes.pop_back();
+    }
+}
+
+void TemplateAnalyzer::collectUnused(int shape, const std::string &path, std::vector<std::string> *paths) const
+{
+    const Shape &current = m_shapes[shape];
+    if (current.element != -1) {
+        collectUnused(current.element, path, paths);
+    }
+    for (const auto &entry : current.keys) {
+        const Shape &child = m_shapes[entry.second];
+        const std::string childPath = path.empty() ? entry.first : path + "." + entry.first;
+        if (child.function) {
+            continue;
+        } else if (!child.used) {
+            paths->push_back(childPath);
+        } else {
+            collectUnused(entry.second, childPath, paths);
+        }
+    }
+}
+
+std::vector<std::string> TemplateAnalyzer::unusedKeys() const
+{
+    std::vector<std::string> paths;
+    collectUnused(0, std::string(), &paths);
+    return paths;
+}
+
+std::string TemplateAnalyzer::report(const std::string &templateName) const
+{
+    std::string report;
+
+    auto location = [&](int pos) {
+        TextPosition position = textPosition(m_source, pos);
+        return templateName + ":" + std::to_string(position.line) + ":" +
+                std::to_string(position.column) + ": ";
+    };
+
+    report += "Unknown keys:\n";
+    for (const Message &message : m_unknownKeys) {
+        report += "  " + location(message.pos) + "'" + message.text + "' is not provided by the model\n";
+    }
+    if (m_unknownKeys.empty()) {
+        report += "  (none)\n";
+    }
+
+    report += "\nUnused model keys:\n";
+    const std::vector<std::string> unused = unusedKeys();
+    for (const std::string &path : unused) {
+        report += "  " + path + "\n";
+    }
+    if (unused.empty()) {
+        report += "  (none)\n";
+    }
+
+    report += "\nLoops:\n";
+    for (const Loop &loop : m_loops) {
+        report += "  " + location(loop.pos) + "{{#" + std::string(loop.key) + "}} depth " +
+                std::to_string(loop.depth + 1) + ", ~" + formatCount(loop.iterations) + " iterations\n";
+    }
+    if (m_loops.empty()) {
+        report += "  (none)\n";
+    }
+
+    report += "\nWarnings:\n";
+    for (const Message &message : m_warnings) {
+        report += "  " + location(message.pos) + message.text + "\n";
+    }
+    if (m_warnings.empty()) {
+        report += "  (none)\n";
+    }
+
+    report += "\nEstimated cost: ~" + formatCount(m_tagCost) + " tag evaluations, ~" +
+            formatCount(m_staticBytes) + " bytes of template text\n";
+
+    return report;
+}
+
+} // namespace protocdoc
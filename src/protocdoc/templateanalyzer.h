@@ -0,0 +1,116 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "mustache.h"
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace protocdoc {
+
+/**
+ * Line and column (both starting at 1) of a position in a template.
+ */
+struct TextPosition {
+    int line;
+    int column;
+};
+
+/**
+ * Returns the line and column of the character at @p pos in @p source.
+ */
+TextPosition textPosition(std::string_view source, int pos);
+
+/**
+ * Static analyzer for Mustache templates.
+ *
+ * Walks a compiled template against the shape of a model (the union of the
+ * keys of all values at each level, and the number of items in its lists),
+ * without rendering it. Reports keys referenced by the template which the
+ * model does not provide, model keys the template never uses, and an estimate
+ * of the rendering cost based on loop nesting and the list sizes of the model.
+ */
+class TemplateAnalyzer {
+public:
+    /**
+     * Analyzes @p template_, which must be valid, against the model @p model.
+     */
+    TemplateAnalyzer(const Mustache::Template &template_, const Mustache::Value &model);
+
+    /**
+     * Returns a human readable report of the analysis. @p templateName is used
+     * as the location in messages.
+     */
+    std::string report(const std::string &templateName) const;
+
+    /**
+     * Returns the dotted paths of the model keys which the template never uses.
+     * If a key is unused, the keys below it are not listed.
+     */
+    std::vector<std::string> unusedKeys() const;
+
+private:
+    /// Union of the values found at one place in the model.
+    struct Shape {
+        bool list = false;
+        bool function = false;
+        size_t instances = 0;               /**< Number of values merged into the shape. */
+        size_t items = 0;                   /**< Total number of list items. */
+        int element = -1;                   /**< Shape of the list items, or -1. */
+        std::map<std::string, int> keys;    /**< Shapes of the map entries. */
+        bool used = false;                  /**< Referenced by the template? */
+    };
+
+    /// A context level while walking the template.
+    struct Scope {
+        int shape;              /**< Shape of the context value, or -1 if it has no keys. */
+        double executions;      /**< Estimated number of times the scope is rendered. */
+        bool iteration;         /**< Entered by iterating over a list? */
+        std::string_view key;   /**< Key of the section which entered the scope. */
+    };
+
+    /// A message about a position in the template.
+    struct Message {
+        int pos;
+        std::string text;
+    };
+
+    /// Estimated cost of one section which iterates over a list.
+    struct Loop {
+        int pos;
+        std::string_view key;
+        int depth;
+        double iterations;
+    };
+
+    int merge(const Mustache::Value &value, int shape);
+    int resolve(std::string_view key, int *scopeIndex) const;
+    void walk(const std::vector<Mustache::Node> &nodes);
+    void collectUnused(int shape, const std::string &path, std::vector<std::string> *paths) const;
+
+    std::string_view m_source;
+    std::vector<Shape> m_shapes;
+    std::vector<Scope> m_scopes;
+    std::vector<Message> m_unknownKeys;
+    std::vector<Message> m_warnings;
+    std::vector<Loop> m_loops;
+    double m_tagCost;
+    double m_staticBytes;
+};
+
+} // namespace protocdoc
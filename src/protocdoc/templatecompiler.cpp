@@ -0,0 +1,303 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "templatecompiler.h"
+
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+namespace ms = Mustache;
+
+namespace protocdoc {
+
+/**
+ * Returns @p text as a C++ string literal, split into one literal per line of
+ * @p text, each but the first preceded by @p indent.
+ */
+static std::string stringLiteral(std::string_view text, const std::string &indent)
+{
+    std::string literal = "\"";
+    for (size_t i = 0; i < text.size(); ++i) {
+        const unsigned char ch = static_cast<unsigned char>(text[i]);
+        switch (ch) {
+        case '\n':
+            literal += "\\n\"";
+            if (i + 1 < text.size()) {
+                literal += "\n" + indent + "\"";
+                continue;
+            }
+            return literal;
+        case '\t':
+            literal += "\\t";
+            break;
+        case '\r':
+            literal += "\\r";
+            break;
+        case '"':
+        case '\\':
+            literal += '\\';
+            literal += static_cast<char>(ch);
+            break;
+        case '?':
+            // Two in a row would start a trigraph.
+            literal += i > 0 && text[i - 1] == '?' ? "\\?" : "?";
+            break;
+        default:
+            if (ch < 0x20 || ch >= 0x7f) {
+                // Always three octal digits, so a following digit is not taken in.
+                char escape[5];
+                std::snprintf(escape, sizeof(escape), "\\%03o", ch);
+                literal += escape;
+            } else {
+                literal += static_cast<char>(ch);
+            }
+        }
+    }
+    return literal + "\"";
+}
+
+/**
+ * Writer of the C++ source of a template module, see compiledTemplateModule().
+ */
+class ModuleWriter {
+public:
+    explicit ModuleWriter(const ms::Template &template_)
+        : m_template(template_)
+        , m_usesEscape(false)
+        , m_usesUnescape(false)
+    {
+    }
+
+    std::string write(const std::string &templateName)
+    {
+        // Write the functions first, which also collects the keys.
+        std::string body = nodesCode(m_template.nodes(), "    ", "return;");
+
+        std::string code = "// Generated by protoc-gen-doc-compile from " + templateName + ". Do not edit.\n"
+                "\n"
+                "#include \"protocdoc/templatemodule.h\"\n"
+                "\n"
+                "#include <string>\n"
+                "#include <string_view>\n"
+                "\n"
+                "namespace {\n"
+                "\n"
+                "namespace ms = Mustache;\n"
+                "\n"
+                "/// Source of the template.\n"
+                "const char source[] =\n"
+                "    " + stringLiteral(m_template.source(), "    ") + ";\n";
+
+        if (!m_keys.empty()) {
+            code += "\n"
+                    "/// Keys referenced by the template.\n"
+                    "const std::string_view keys[] = {\n";
+            for (std::string_view key : m_keys) {
+                code += "    std::string_view(" + stringLiteral(key, "        ") + ", " +
+                        std::to_string(key.size()) + "),\n";
+            }
+            code += "};\n";
+        }
+
+        if (m_usesEscape) {
+            code += "\n"
+                    "void appendEscapedHtml(std::string *output, std::string_view input)\n"
+                    "{\n"
+                    "    size_t last = 0;\n"
+                    "    for (size_t i = 0; i < input.size(); ++i) {\n"
+                    "        const char *replacement = nullptr;\n"
+                    "        switch (input[i]) {\n"
+                    "        case '&': replacement = \"&amp;\"; break;\n"
+                    "        case '<': replacement = \"&lt;\"; break;\n"
+                    "        case '>': replacement = \"&gt;\"; break;\n"
+                    "        case '\"': replacement = \"&quot;\"; break;\n"
+                    "        default: continue;\n"
+                    "        }\n"
+                    "        output->append(input.data() + last, i - last);\n"
+                    "        output->append(replacement);\n"
+                    "        last = i + 1;\n"
+                    "    }\n"
+                    "    output->append(input.data() + last, input.size() - last);\n"
+                    "}\n";
+        }
+        if (m_usesUnescape) {
+            code += "\n"
+                    "void replaceAll(std::string *text, std::string_view before, std::string_view after)\n"
+                    "{\n"
+                    "    size_t pos = text->find(before);\n"
+                    "    while (pos != std::string::npos) {\n"
+                    "        text->replace(pos, before.size(), after);\n"
+                    "        pos = text->find(before, pos + after.size());\n"
+                    "    }\n"
+                    "}\n"
+                    "\n"
+                    "void appendUnescapedHtml(std::string *output, std::string_view escaped)\n"
+                    "{\n"
+                    "    std::string unescaped(escaped);\n"
+                    "    replaceAll(&unescaped, \"&lt;\", \"<\");\n"
+                    "    replaceAll(&unescaped, \"&gt;\", \">\");\n"
+                    "    replaceAll(&unescaped, \"&amp;\", \"&\");\n"
+                    "    replaceAll(&unescaped, \"&quot;\", \"\\\"\");\n"
+                    "    output->append(unescaped);\n"
+                    "}\n";
+        }
+
+        for (const std::string &function : m_functions) {
+            code += "\n" + function;
+        }
+
+        code += "\n"
+                "void render([[maybe_unused]] ms::Context *context, ms::Renderer *renderer,\n"
+                "            const ms::RenderHooks *hooks, std::string *output)\n"
+                "{\n" +
+                body +
+                "}\n"
+                "\n"
+                "const protocdoc::TemplateModule module = {\n"
+                "    protocdoc::TemplateModuleVersion, source, sizeof(source) - 1, &render\n"
+                "};\n"
+                "\n"
+                "} // namespace\n"
+                "\n"
+                "extern \"C\" PROTOCDOC_MODULE_EXPORT const protocdoc::TemplateModule *protocDocTemplateModule()\n"
+                "{\n"
+                "    return &module;\n"
+                "}\n";
+        return code;
+    }
+
+private:
+    /// Returns the expression for @p key in the keys table.
+    std::string keyCode(std::string_view key)
+    {
+        auto it = m_keyIndexes.find(key);
+        if (it == m_keyIndexes.end()) {
+            it = m_keyIndexes.emplace(key, static_cast<int>(m_keys.size())).first;
+            m_keys.push_back(key);
+        }
+        return "keys[" + std::to_string(it->second) + "]";
+    }
+
+    /// Writes a function rendering @p nodes and returns its name.
+    std::string sectionFunction(const std::vector<ms::Node> &nodes)
+    {
+        std::string body = nodesCode(nodes, "    ", "return false;");
+        const std::string name = "renderSection" + std::to_string(m_functions.size() + 1);
+        m_functions.push_back("bool " + name + "([[maybe_unused]] ms::Context *context, ms::Renderer *renderer,\n" +
+                              std::string(name.size() + 6, ' ') +
+                              "const ms::RenderHooks *hooks, std::string *output)\n"
+                              "{\n" + body + "    return true;\n}\n");
+        return name;
+    }
+
+    /// Returns the statements rendering @p nodes, ending with @p failure if the render stops.
+    std::string nodesCode(const std::vector<ms::Node> &nodes, const std::string &indent, const char *failure)
+    {
+        const std::string arguments = "(context, renderer, hooks, output)";
+        std::string code;
+        for (const ms::Node &node : nodes) {
+            switch (node.type) {
+            case ms::Node::Text:
+                code += indent + "output->append(" + stringLiteral(node.text, indent + "               ") +
+                        ", " + std::to_string(node.text.size()) + ");\n";
+                break;
+            case ms::Node::Value:
+            {
+                const std::string value = "context->stringValue(" + keyCode(node.text) + ")";
+                if (node.escapeMode == ms::Tag::Escape) {
+                    m_usesEscape = true;
+                    code += indent + "appendEscapedHtml(output, " + value + ");\n";
+                } else if (node.escapeMode == ms::Tag::Unescape) {
+                    m_usesUnescape = true;
+                    code += indent + "appendUnescapedHtml(output, " + value + ");\n";
+                } else {
+                    code += indent + "output->append(" + value + ");\n";
+                }
+            }
+            break;
+            case ms::Node::Section:
+            {
+                // The same calls as Renderer makes for a section.
+                const std::string key = keyCode(node.text);
+                const std::string function = sectionFunction(node.children);
+                const std::string pos = std::to_string(node.pos);
+                const size_t offset = node.source.data() - m_template.source().data();
+                code += indent + "if (!hooks->enter(renderer, " + pos + ")) {\n" +
+                        indent + "    " + failure + "\n" +
+                        indent + "}\n" +
+                        indent + "if (const int count = context->listCount(" + key + "); count > 0) {\n" +
+                        indent + "    for (int index = 0; index < count; ++index) {\n" +
+                        indent + "        context->push(" + key + ", index);\n" +
+                        indent + "        const bool ok = " + function + arguments + ";\n" +
+                        indent + "        context->pop();\n" +
+                        indent + "        if (!ok) {\n" +
+                        indent + "            " + failure + "\n" +
+                        indent + "        }\n" +
+                        indent + "    }\n" +
+                        indent + "} else if (context->canEval(" + key + ")) {\n" +
+                        indent + "    if (!hooks->eval(renderer, " + key + ", std::string_view(source + " +
+                        std::to_string(offset) + ", " + std::to_string(node.source.size()) + "), " + pos +
+                        ", context, output)) {\n" +
+                        indent + "        " + failure + "\n" +
+                        indent + "    }\n" +
+                        indent + "} else if (!context->isFalse(" + key + ")) {\n" +
+                        indent + "    context->push(" + key + ");\n" +
+                        indent + "    const bool ok = " + function + arguments + ";\n" +
+                        indent + "    context->pop();\n" +
+                        indent + "    if (!ok) {\n" +
+                        indent + "        " + failure + "\n" +
+                        indent + "    }\n" +
+                        indent + "}\n" +
+                        indent + "hooks->leave(renderer);\n";
+            }
+            break;
+            case ms::Node::InvertedSection:
+            {
+                const std::string key = keyCode(node.text);
+                const std::string function = sectionFunction(node.children);
+                code += indent + "if (context->isFalse(" + key + ") && !" + function + arguments + ") {\n" +
+                        indent + "    " + failure + "\n" +
+                        indent + "}\n";
+            }
+            break;
+            case ms::Node::Partial:
+                code += indent + "if (!hooks->renderPartial(renderer, " + keyCode(node.text) + ", " +
+                        std::to_string(node.pos) + ", context, output)) {\n" +
+                        indent + "    " + failure + "\n" +
+                        indent + "}\n";
+                break;
+            }
+            // Renderer checks the limits after every node.
+            code += indent + "if (!hooks->withinLimits(renderer, " + std::to_string(node.pos) + ", *output)) {\n" +
+                    indent + "    " + failure + "\n" +
+                    indent + "}\n";
+        }
+        return code;
+    }
+
+    const ms::Template &m_template;
+    std::vector<std::string_view> m_keys;
+    std::unordered_map<std::string_view, int> m_keyIndexes;
+    std::vector<std::string> m_functions;
+    bool m_usesEscape;
+    bool m_usesUnescape;
+};
+
+std::string compiledTemplateModule(const ms::Template &template_, const std::string &templateName)
+{
+    return ModuleWriter(template_).write(templateName);
+}
+
+} // namespace protocdoc
@@ -0,0 +1,37 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "mustache.h"
+
+#include <string>
+
+namespace protocdoc {
+
+/**
+ * Translates @p template_ into the C++ source of a template module.
+ *
+ * The generated code renders the template with straight-line code: literal text
+ * is appended as is, and each tag becomes the calls on the context that the
+ * renderer would make for it, with the keys resolved at compile time. Section
+ * bodies become functions of their own, so code size stays linear in the size of
+ * the template. @p templateName is mentioned in a comment in the generated code.
+ *
+ * The module, built as a shared library, only depends on the C++ standard library
+ * and the headers of protocdoc, see TemplateModule.
+ */
+std::string compiledTemplateModule(const Mustache::Template &template_, const std::string &templateName);
+
+} // namespace protocdoc
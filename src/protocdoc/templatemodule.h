@@ -0,0 +1,53 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "mustache.h"
+
+#include <cstddef>
+
+#if defined(_WIN32)
+#define PROTOCDOC_MODULE_EXPORT __declspec(dllexport)
+#else
+#define PROTOCDOC_MODULE_EXPORT __attribute__((visibility("default")))
+#endif
+
+namespace protocdoc {
+
+/**
+ * Version of the interface between the plugin and template modules. It changes
+ * whenever TemplateModule, Mustache::RenderHooks or the virtual functions of
+ * Mustache::Context change, and the plugin refuses to load modules built for
+ * another version.
+ */
+const int TemplateModuleVersion = 2;
+
+/**
+ * A template translated to C++ and built into a loadable module.
+ *
+ * Modules are written by protocdoc::compiledTemplateModule() and export a function
+ *
+ *     extern "C" const protocdoc::TemplateModule *protocDocTemplateModule();
+ *
+ * returning the description of the template.
+ */
+struct TemplateModule {
+    int version;                        /**< TemplateModuleVersion of the module. */
+    const char *source;                 /**< Template source the module was compiled from. */
+    size_t sourceSize;                  /**< Size of the template source. */
+    Mustache::RenderFunction render;    /**< Renders the template. */
+};
+
+} // namespace protocdoc
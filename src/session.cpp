@@ -0,0 +1,507 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "session.h"
+#include "legacy/legacy.h"
+#include "protocdoc/json.h"
+#include "protocdoc/manifest.h"
+#include "protocdoc/searchindex.h"
+
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QString>
+#include <QStringList>
+
+#ifdef HAVE_LUA
+#include "luafilters.h"
+#endif
+
+#include <google/protobuf/compiler/code_generator.h>
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/io/printer.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+
+namespace gp = google::protobuf;
+namespace ms = Mustache;
+
+void ExtractedFileCache::extract(const gp::FileDescriptor *fileDescriptor,
+                                 const protocdoc::ExtractOptions &options, ms::Value *files, std::string *error)
+{
+    // The file description is read from disk, so the absolute path of the file
+    // is part of the key too.
+    const std::string diskFileName = options.diskFileName ?
+            options.diskFileName(fileDescriptor->name()) : fileDescriptor->name();
+    std::string key(options.noExclude ? "1" : "0");
+    key += options.elementHashes ? '1' : '0';
+    key += options.selection.key();
+    key += QDir::current().absoluteFilePath(QString::fromStdString(diskFileName)).toStdString();
+    key += '\0';
+
+    gp::FileDescriptorProto proto;
+    fileDescriptor->CopyTo(&proto);
+    fileDescriptor->CopySourceCodeInfoTo(&proto);
+    proto.AppendToString(&key);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_files.find(key);
+        if (it != m_files.end()) {
+            for (const ms::Value &file : it->second.list()) {
+                files->append(file);
+            }
+            return;
+        }
+    }
+
+    // Extract without holding the lock, so that sessions in other threads are
+    // not held up. Two sessions may then extract the same file, which is harmless.
+    ms::Value extracted = ms::Value::list_t();
+    protocdoc::addFile(fileDescriptor, options, &extracted, error);
+    if (!error->empty()) {
+        return;
+    }
+    extracted = protocdoc::detached(extracted);
+    for (const ms::Value &file : extracted.list()) {
+        files->append(file);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_files.size() >= MaxFiles) {
+        m_files.clear();
+    }
+    m_files.emplace(std::move(key), std::move(extracted));
+}
+
+GenerationSession::GenerationSession(ExtractedFileCache *cache, const std::string &workingDirectory,
+                                     std::string *diagnostics)
+    : m_cache(cache)
+    , m_workingDirectory(workingDirectory)
+    , m_diagnostics(diagnostics)
+{
+}
+
+GenerationSession::~GenerationSession()
+{
+    reset();
+}
+
+bool GenerationSession::addFile(const gp::FileDescriptor *fileDescriptor, bool isFirst, bool isLast,
+                                const std::string &parameter, gp::compiler::GeneratorContext *context,
+                                std::string *error)
+{
+    if (isFirst) {
+        // Start over, the session may have generated documentation before.
+        reset();
+
+        // Parse the plugin parameter.
+        if (!parseParameter(parameter, error)) {
+            return false;
+        }
+    }
+
+    // Templates whose only use of the files is one top-level {{#files}}
+    // section are rendered one file at a time, so that memory use does not
+    // grow with the size of the request.
+    if (!m_checkTemplate && !m_searchIndex && !m_manifest && m_engine == RenderEngine::Value &&
+            FileStreamRenderer::canStream(m_template)) {
+        if (!streamFile(fileDescriptor, isFirst, isLast, context, error)) {
+            // Close the output while the generator context is still alive.
+            reset();
+            return false;
+        }
+        return true;
+    }
+
+    // Parse the file.
+    extractFile(fileDescriptor, &m_files, error);
+    if (!error->empty()) {
+        return false;
+    }
+    if (m_engine != RenderEngine::Value) {
+        // The legacy engine renders its own model of the file.
+        legacy::addFile(fileDescriptor, m_extractOptions, &m_legacyFiles, error);
+        if (!error->empty()) {
+            return false;
+        }
+    }
+
+    if (isLast) {
+        // Render output, handing over the files.
+        const bool rendered = render(context, error);
+        m_files = ms::Value::list_t();
+        m_legacyFiles.clear();
+        return rendered;
+    }
+
+    return true;
+}
+
+/**
+ * Clears the files and closes the output of the session.
+ */
+void GenerationSession::reset()
+{
+    m_files = ms::Value::list_t();
+    m_legacyFiles.clear();
+    m_writer.reset();
+    m_stream.reset();
+    m_streamRenderer.reset();
+}
+
+/**
+ * Returns @p path resolved against the working directory of the session, if it
+ * has one and @p path is relative.
+ */
+QString GenerationSession::resolvedPath(const QString &path) const
+{
+    if (m_workingDirectory.empty()) {
+        return path;
+    }
+    return QDir(QString::fromStdString(m_workingDirectory)).filePath(path);
+}
+
+/**
+ * Writes the line @p message to standard error, or appends it to the
+ * diagnostics of the session if it collects them.
+ */
+void GenerationSession::printDiagnostic(const std::string &message)
+{
+    if (m_diagnostics) {
+        *m_diagnostics += message + '\n';
+    } else {
+        std::cerr << message << std::endl;
+    }
+}
+
+/**
+ * Adds the file described by @p fileDescriptor to the list @p files, through
+ * the cache of the session if it has one. If an error occurs, @p error is set
+ * to point to an error message.
+ */
+void GenerationSession::extractFile(const gp::FileDescriptor *fileDescriptor, ms::Value *files,
+                                    std::string *error)
+{
+    if (m_cache) {
+        m_cache->extract(fileDescriptor, m_extractOptions, files, error);
+    } else {
+        protocdoc::addFile(fileDescriptor, m_extractOptions, files, error);
+    }
+}
+
+/**
+ * Returns a usage help string.
+ */
+static QString usage()
+{
+    return QString(
+        "Usage: --doc_out=%1|<TEMPLATE_FILENAME>|module=<LIBRARY>,<OUT_FILENAME>[,no-exclude][,check-template][,search-index][,collapse-whitespace][,manifest]"
+        "[,memoize][,engine=value|variant|verify][,max-depth=N][,max-output=BYTES][,time-budget=MS]"
+        "[,lua=<SCRIPT_FILENAME>][,include=<RULE>]...[,exclude=<RULE>]...:<OUT_DIR>\n"
+        "where RULE is package=<GLOB>, file=<GLOB> or name=<REGEX>")
+        .arg(supportedFormats().join("|"));
+}
+
+/**
+ * Parses the token @p token of the form NAME=N, where N is a non-negative number
+ * no larger than @p maximum, into @p value.
+ *
+ * @return true if @p token starts with "NAME=", otherwise false. If the number is
+ * invalid, @p error is set to point to an error message.
+ */
+static bool parseNumberToken(const QString &token, const QString &name, qulonglong maximum,
+                             qulonglong *value, std::string *error)
+{
+    if (!token.startsWith(name + "=")) {
+        return false;
+    }
+    bool ok = false;
+    *value = token.mid(name.size() + 1).toULongLong(&ok);
+    if (!ok || *value > maximum) {
+        *error = token.toStdString() + ": Expected a non-negative number";
+    }
+    return true;
+}
+
+/**
+ * Parses the plugin parameter string.
+ *
+ * @param parameter Plugin parameter string.
+ * @param error Pointer to error if parsing failed.
+ * @return true on success, otherwise false.
+ */
+bool GenerationSession::parseParameter(const std::string &parameter, std::string *error)
+{
+    QStringList tokens = QString::fromStdString(parameter).split(",");
+
+    if (tokens.size() < 2) {
+        *error = usage().toStdString();
+        return false;
+    }
+
+    bool noExclude = false;
+    bool checkTemplate = false;
+    bool searchIndex = false;
+    bool collapseWhitespace = false;
+    bool manifest = false;
+    bool memoize = false;
+    RenderEngine engine = RenderEngine::Value;
+    bool hasEngine = false;
+    ms::RenderLimits renderLimits;
+    QString luaScript;
+    protocdoc::Selection selection;
+    for (int i = 2; i < tokens.size(); ++i) {
+        qulonglong number = 0;
+        if (parseNumberToken(tokens.at(i), "max-depth", INT_MAX, &number, error)) {
+            renderLimits.maxDepth = static_cast<int>(number);
+        } else if (parseNumberToken(tokens.at(i), "max-output", SIZE_MAX, &number, error)) {
+            renderLimits.maxOutputSize = static_cast<size_t>(number);
+        } else if (parseNumberToken(tokens.at(i), "time-budget", LLONG_MAX, &number, error)) {
+            renderLimits.timeBudget = std::chrono::milliseconds(static_cast<long long>(number));
+        } else if (tokens.at(i).startsWith("engine=") && !hasEngine) {
+            hasEngine = true;
+            if (!parseRenderEngine(tokens.at(i).mid(7).toStdString(), &engine)) {
+                *error = tokens.at(i).toStdString() + ": Expected value, variant or verify";
+            }
+        } else if (tokens.at(i).startsWith("include=") || tokens.at(i).startsWith("exclude=")) {
+            // Any number of these, evaluated before the files are visited.
+            selection.addRule(tokens.at(i).startsWith("include="), tokens.at(i).mid(8).toStdString(), error);
+        } else if (tokens.at(i).startsWith("lua=") && luaScript.isEmpty()) {
+            luaScript = tokens.at(i).mid(4);
+        } else if (tokens.at(i) == "no-exclude" && !noExclude) {
+            noExclude = true;
+        } else if (tokens.at(i) == "check-template" && !checkTemplate) {
+            checkTemplate = true;
+        } else if (tokens.at(i) == "search-index" && !searchIndex) {
+            searchIndex = true;
+        } else if (tokens.at(i) == "collapse-whitespace" && !collapseWhitespace) {
+            collapseWhitespace = true;
+        } else if (tokens.at(i) == "manifest" && !manifest) {
+            manifest = true;
+        } else if (tokens.at(i) == "memoize" && !memoize) {
+            memoize = true;
+        } else {
+            *error = usage().toStdString();
+            return false;
+        }
+        if (!error->empty()) {
+            return false;
+        }
+    }
+
+    // Template files, modules and scripts are relative to the working directory.
+    // A module that is not there may be in the system library paths.
+    QString templateFileName = tokens.at(0);
+    if (templateFileName.startsWith("module=")) {
+        const QString path = resolvedPath(templateFileName.mid(7));
+        if (QFileInfo::exists(path)) {
+            templateFileName = "module=" + path;
+        }
+    } else if (templateFileName != "json" && !supportedFormats().contains(templateFileName)) {
+        templateFileName = resolvedPath(templateFileName);
+    }
+    if (!loadTemplate(templateFileName.toStdString(), &m_template, error, collapseWhitespace)) {
+        return false;
+    }
+    if (checkTemplate && m_template.source().empty()) {
+        *error = "check-template requires a template";
+        return false;
+    }
+    if (searchIndex && m_template.source().empty()) {
+        *error = "search-index requires a template";
+        return false;
+    }
+    if (engine != RenderEngine::Value && (!selection.empty() || !luaScript.isEmpty())) {
+        // The legacy engine predates both.
+        *error = "include, exclude and lua require engine=value";
+        return false;
+    }
+    ms::Value filters;
+    if (!luaScript.isEmpty()) {
+#ifdef HAVE_LUA
+        // Compiled once here, and called for every section using a filter.
+        if (!loadLuaFilters(resolvedPath(luaScript).toStdString(), &filters, error)) {
+            return false;
+        }
+#else
+        *error = "lua requires protoc-gen-doc to be built with Lua";
+        return false;
+#endif
+    }
+    m_templateName = tokens.at(0).toStdString();
+    m_outputFileName = tokens.at(1).toStdString();
+    if (!m_workingDirectory.empty()) {
+        const QDir directory(QString::fromStdString(m_workingDirectory));
+        m_extractOptions.diskFileName = [directory](const std::string &name) {
+            return directory.filePath(QString::fromStdString(name)).toStdString();
+        };
+    }
+    m_extractOptions.noExclude = noExclude;
+    m_extractOptions.elementHashes = manifest;
+    m_extractOptions.selection = std::move(selection);
+    m_checkTemplate = checkTemplate;
+    m_searchIndex = searchIndex;
+    m_manifest = manifest;
+    m_renderLimits = renderLimits;
+    m_memoize = memoize;
+    m_engine = engine;
+    m_filters = std::move(filters);
+
+    return true;
+}
+
+/**
+ * Returns the name of a file written next to the output file @p outputFileName,
+ * which is its name with the extension replaced by @p extension, e.g. ".search.js".
+ */
+static std::string companionFileName(const std::string &outputFileName, const char *extension)
+{
+    const size_t slash = outputFileName.find_last_of('/');
+    const size_t dot = outputFileName.find_last_of('.');
+    const bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash + 1);
+    return outputFileName.substr(0, hasExtension ? dot : std::string::npos) + extension;
+}
+
+/**
+ * Writes @p contents to the file @p fileName in the output directory of @p context.
+ */
+static void writeFile(gp::compiler::GeneratorContext *context, const std::string &fileName,
+                      const std::string &contents)
+{
+    std::unique_ptr<gp::io::ZeroCopyOutputStream> stream(context->Open(fileName));
+    gp::io::Printer printer(stream.get(), '$');
+    printer.PrintRaw(contents);
+}
+
+/**
+ * Renders the list of files.
+ *
+ * Renders files to the directory specified in @p context. If an error occurred,
+ * @p error is set to point to an error message and no output is written.
+ *
+ * @param context Compiler generator context specifying the output directory.
+ * @param error Pointer to error if rendering failed.
+ * @return true on success, otherwise false.
+ */
+bool GenerationSession::render(gp::compiler::GeneratorContext *context, std::string *error)
+{
+    // Build the search index while the files are at hand, and tell the template
+    // where to load it from. Without an index, search_index is an empty string.
+    ms::Value arguments;
+    std::string indexFileName;
+    std::string index;
+    if (m_searchIndex && !m_checkTemplate) {
+        indexFileName = companionFileName(m_outputFileName, ".search.js");
+        index = "window.protocDocSearchIndex = " + protocdoc::searchIndex(m_files) + ";\n";
+    }
+    arguments["search_index"] = indexFileName.substr(indexFileName.find_last_of('/') + 1);
+    for (const auto &filter : m_filters.map()) {
+        arguments[filter.first] = filter.second;
+    }
+
+    // Likewise the manifest of the elements, before the files are handed over.
+    ms::Value manifest;
+    if (m_manifest) {
+        manifest = protocdoc::manifest(m_files);
+    }
+
+    std::string result;
+    std::string report;
+    if (!renderDocument(m_template, m_templateName,
+                        m_checkTemplate, std::move(m_files), &result, error,
+                        arguments, m_renderLimits, m_memoize,
+                        m_engine, &m_legacyFiles, &report)) {
+        return false;
+    }
+    if (!report.empty()) {
+        printDiagnostic("protoc-gen-doc: " + report);
+    }
+
+    if (!indexFileName.empty()) {
+        writeFile(context, indexFileName, index);
+    }
+
+    // Write output.
+    writeFile(context, m_outputFileName, result);
+
+    if (m_manifest) {
+        protocdoc::addManifestOutput(m_outputFileName, result, &manifest);
+        if (!indexFileName.empty()) {
+            protocdoc::addManifestOutput(indexFileName, index, &manifest);
+        }
+        writeFile(context, companionFileName(m_outputFileName, ".manifest.json"),
+                  protocdoc::toJson(manifest));
+    }
+
+    return true;
+}
+
+/**
+ * Renders the file described by @p fileDescriptor when rendering one file at a
+ * time.
+ *
+ * The part of the template before the files is rendered for the first file, and
+ * the part after them for the last file. If an error occurred, @p error is set to
+ * point to an error message.
+ *
+ * @return true on success, otherwise false.
+ */
+bool GenerationSession::streamFile(const gp::FileDescriptor *fileDescriptor, bool isFirst, bool isLast,
+                                   gp::compiler::GeneratorContext *context, std::string *error)
+{
+    std::string output;
+
+    if (isFirst) {
+        m_streamRenderer.reset(
+                    new FileStreamRenderer(m_template, m_templateName,
+                                           m_filters, m_renderLimits,
+                                           m_memoize));
+        m_stream.reset(context->Open(m_outputFileName));
+        m_writer.reset(new AsyncOutputWriter(m_stream.get()));
+        if (!m_streamRenderer->begin(&output, error)) {
+            return false;
+        }
+    }
+
+    // Extract, render and release the file.
+    ms::Value files = ms::Value::list_t();
+    extractFile(fileDescriptor, &files, error);
+    if (!error->empty() || !m_streamRenderer->addFiles(std::move(files), &output, error)) {
+        return false;
+    }
+
+    if (isLast && !m_streamRenderer->end(&output, error)) {
+        return false;
+    }
+    // The writer thread writes this file while the next one is rendered.
+    m_writer->write(output);
+
+    if (isLast) {
+        const bool written = m_writer->close();
+        m_writer.reset();
+        m_stream.reset();
+        m_streamRenderer.reset();
+        if (!written) {
+            *error = "Failed to write " + m_outputFileName;
+            return false;
+        }
+    }
+
+    return true;
+}
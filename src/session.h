@@ -0,0 +1,131 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include "generator.h"
+#include "outputwriter.h"
+#include "protocdoc/model.h"
+#include "protocdoc/mustache.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <QString>
+#include <QVariantList>
+
+namespace google { namespace protobuf {
+class FileDescriptor;
+namespace io { class ZeroCopyOutputStream; }
+namespace compiler { class GeneratorContext; }
+} }
+
+/**
+ * Cache of extracted files, keyed by the contents of their descriptors.
+ *
+ * A daemon shares one cache between the sessions of its requests, so that a
+ * file common to many requests is extracted once. This class is thread-safe.
+ */
+class ExtractedFileCache
+{
+public:
+    /**
+     * Appends the files extracted from @p fileDescriptor with @p options to the
+     * list @p files, extracting them only if they are not in the cache. If an
+     * error occurs, @p error is set to point to an error message.
+     */
+    void extract(const google::protobuf::FileDescriptor *fileDescriptor,
+                 const protocdoc::ExtractOptions &options, Mustache::Value *files, std::string *error);
+
+private:
+    static const size_t MaxFiles = 4096;
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Mustache::Value> m_files; /**< Detached files by key. */
+};
+
+/**
+ * One generation of documentation from a set of files.
+ *
+ * A session holds everything a generation needs from the first file to the
+ * last: the options parsed from the plugin parameter, the template, the files
+ * extracted so far and the output being streamed. Sessions share no state
+ * except an optional ExtractedFileCache, so independent sessions may run in
+ * parallel threads, and one process may run any number of them in turn.
+ */
+class GenerationSession
+{
+public:
+    /**
+     * Creates a session extracting files through @p cache, which must outlive it,
+     * or extracting every file itself if @p cache is null.
+     *
+     * Relative paths of files, templates and scripts are resolved against
+     * @p workingDirectory, or the working directory of the process if empty.
+     * Messages for standard error are appended to @p diagnostics if not null,
+     * and written to std::cerr otherwise.
+     */
+    explicit GenerationSession(ExtractedFileCache *cache = nullptr,
+                               const std::string &workingDirectory = std::string(),
+                               std::string *diagnostics = nullptr);
+    GenerationSession(const GenerationSession &) = delete;
+    GenerationSession &operator=(const GenerationSession &) = delete;
+    ~GenerationSession();
+
+    /**
+     * Adds the file described by @p fileDescriptor to the documentation.
+     *
+     * The first file starts the session over with the options in the plugin
+     * parameter @p parameter, and the last file completes the documentation in
+     * the output directory of @p context. Files must be given in the order they
+     * were parsed. If an error occurred, @p error is set to point to an error
+     * message and false is returned.
+     */
+    bool addFile(const google::protobuf::FileDescriptor *fileDescriptor, bool isFirst, bool isLast,
+                 const std::string &parameter, google::protobuf::compiler::GeneratorContext *context,
+                 std::string *error);
+
+private:
+    void reset();
+    QString resolvedPath(const QString &path) const;
+    void printDiagnostic(const std::string &message);
+    bool parseParameter(const std::string &parameter, std::string *error);
+    void extractFile(const google::protobuf::FileDescriptor *fileDescriptor, Mustache::Value *files,
+                     std::string *error);
+    bool render(google::protobuf::compiler::GeneratorContext *context, std::string *error);
+    bool streamFile(const google::protobuf::FileDescriptor *fileDescriptor, bool isFirst, bool isLast,
+                    google::protobuf::compiler::GeneratorContext *context, std::string *error);
+
+    ExtractedFileCache *m_cache;
+    std::string m_workingDirectory;     /**< Directory relative paths refer to, or empty for the current one. */
+    std::string *m_diagnostics;         /**< Messages for standard error, or null to write them to std::cerr. */
+    Mustache::Template m_template;      /**< Compiled Mustache template, or empty for raw JSON output. */
+    std::string m_templateName;         /**< Template format or file name, used in messages. */
+    std::string m_outputFileName;       /**< Output filename. */
+    protocdoc::ExtractOptions m_extractOptions; /**< Options for extracting files. */
+    bool m_checkTemplate = false;       /**< Write a template analysis instead of documentation? */
+    bool m_searchIndex = false;         /**< Write a search index next to the output? */
+    bool m_manifest = false;            /**< Write a manifest of the output next to it? */
+    Mustache::RenderLimits m_renderLimits; /**< Limits on rendering. */
+    bool m_memoize = false;             /**< Memoize repeated sections when rendering? */
+    RenderEngine m_engine = RenderEngine::Value; /**< Engine rendering the template. */
+    Mustache::Value m_filters;          /**< Map of user-defined template filters. */
+    Mustache::Value m_files = Mustache::Value::list_t(); /**< List of files to render. */
+    QVariantList m_legacyFiles;         /**< List of files to render with the legacy engine. */
+    std::unique_ptr<FileStreamRenderer> m_streamRenderer; /**< Renderer when rendering one file at a time. */
+    std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> m_stream; /**< Output stream when rendering one file at a time. */
+    std::unique_ptr<AsyncOutputWriter> m_writer; /**< Writer thread writing to m_stream. */
+};
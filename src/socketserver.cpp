@@ -0,0 +1,93 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "socketserver.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // Not available on macOS, SO_NOSIGPIPE is set instead.
+#endif
+
+bool sendAll(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        } else if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+void serveConnections(int server, unsigned jobs, int timeout, const std::function<void(int client)> &handleClient)
+{
+    // A client that goes away must not terminate the server.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    auto work = [&]() {
+        std::chrono::milliseconds backoff(0);
+        while (true) {
+            int client = accept(server, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                // E.g. out of file descriptors, which may pass once other
+                // clients are done, so wait a little longer each time.
+                std::cerr << "accept: " << std::strerror(errno) << std::endl;
+                backoff = std::min(std::max(2 * backoff, std::chrono::milliseconds(10)),
+                                   std::chrono::milliseconds(1000));
+                std::this_thread::sleep_for(backoff);
+                continue;
+            }
+            backoff = std::chrono::milliseconds(0);
+
+            timeval clientTimeout = { timeout, 0 };
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &clientTimeout, sizeof(clientTimeout));
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &clientTimeout, sizeof(clientTimeout));
+#ifdef SO_NOSIGPIPE
+            int noSigPipe = 1;
+            setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+            handleClient(client);
+            close(client);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < jobs; ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
@@ -0,0 +1,37 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+/**
+ * Sends all of @p data on the socket @p fd without raising SIGPIPE.
+ *
+ * Returns true on success, otherwise false.
+ */
+bool sendAll(int fd, const char *data, size_t size);
+
+/**
+ * Serves the connections on the listening socket @p server until killed.
+ *
+ * Runs @p jobs workers, each accepting connections of its own and passing them
+ * to @p handleClient, which may be called from several threads at once. A
+ * connection is closed once @p handleClient returns. Sending or receiving on it
+ * fails after @p timeout seconds without progress, so that a stalled client
+ * does not hold up the worker, and a client that goes away does not raise
+ * SIGPIPE.
+ */
+void serveConnections(int server, unsigned jobs, int timeout, const std::function<void(int client)> &handleClient);
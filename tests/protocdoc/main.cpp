@@ -0,0 +1,225 @@
+/*
+  Copyright 2014, 2015, 2016 Elvis Stansvik
+
+  Redistribution and use in source and binary forms, with or without modification,
+  are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+    Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+*/
+
+#include "protocdoc/filters.h"
+#include "protocdoc/json.h"
+#include "protocdoc/mustache.h"
+#include "protocdoc/searchindex.h"
+#include "protocdoc/templateanalyzer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ms = Mustache;
+
+/// Number of failed checks.
+static int failures = 0;
+
+/**
+ * Counts a failure and prints @p message with the line @p line if @p condition
+ * is false. Unlike assert(), checks are also made in release builds.
+ */
+static void check(bool condition, int line, const std::string &message)
+{
+    if (!condition) {
+        std::cerr << __FILE__ << ":" << line << ": Check failed: " << message << std::endl;
+        ++failures;
+    }
+}
+
+#define CHECK(condition) check((condition), __LINE__, #condition)
+
+/**
+ * Returns true if the analysis of @p source against @p model reports no unknown keys.
+ */
+static bool allKeysKnown(const std::string &source, const ms::Value &model)
+{
+    const ms::Template template_(source);
+    if (!template_.isValid()) {
+        return false;
+    }
+    const protocdoc::TemplateAnalyzer analyzer(template_, model);
+    return analyzer.report("test").find("Unknown keys:\n  (none)\n") != std::string::npos;
+}
+
+/**
+ * Returns true if the analysis of @p source against @p model lists @p key as unused.
+ */
+static bool isUnused(const std::string &source, const ms::Value &model, const std::string &key)
+{
+    const protocdoc::TemplateAnalyzer analyzer(ms::Template(source), model);
+    const std::vector<std::string> unused = analyzer.unusedKeys();
+    return std::find(unused.begin(), unused.end(), key) != unused.end();
+}
+
+/**
+ * A section over a scalar pushes the value, so "." inside it is that value.
+ */
+static void testScalarSection()
+{
+    ms::Value model;
+    model["pkg"] = "acme.booking";
+    model["count"] = 3;
+    model["flag"] = true;
+
+    CHECK(allKeysKnown("{{#pkg}}{{.}}{{/pkg}}", model));
+    CHECK(allKeysKnown("{{#count}}{{.}}{{/count}}", model));
+    CHECK(allKeysKnown("{{#flag}}{{.}}{{/flag}}", model));
+    CHECK(!isUnused("{{#pkg}}{{.}}{{/pkg}}", model, "pkg"));
+
+    // Keys not in the scalar are looked up in the enclosing scopes.
+    CHECK(allKeysKnown("{{#pkg}}{{count}}{{/pkg}}", model));
+    CHECK(!allKeysKnown("{{#pkg}}{{missing}}{{/pkg}}", model));
+}
+
+/**
+ * Sections over maps and lists, and inverted sections.
+ */
+static void testOtherSections()
+{
+    ms::Value file;
+    file["file_name"] = "Booking.proto";
+    ms::Value model;
+    model["files"] = ms::Value::list_t{file};
+    model["first"] = file;
+
+    CHECK(allKeysKnown("{{#files}}{{file_name}}{{/files}}", model));
+    CHECK(allKeysKnown("{{#first}}{{file_name}}{{/first}}", model));
+    CHECK(!allKeysKnown("{{#files}}{{package}}{{/files}}", model));
+
+    // Inverted sections render in the current scope, where "." is the model.
+    CHECK(allKeysKnown("{{^files}}{{.}}{{/files}}", model));
+    CHECK(allKeysKnown("{{#first}}{{^file_name}}{{file_name}}{{/file_name}}{{/first}}", model));
+    CHECK(isUnused("{{#files}}{{/files}}", model, "first"));
+}
+
+/**
+ * Returns @p source rendered against @p model, with or without memoization.
+ */
+static std::string rendered(const std::string &source, const ms::Value &model, bool memoization)
+{
+    ms::ValueContext context(model);
+    ms::Renderer renderer;
+    renderer.setMemoization(memoization);
+    return renderer.render(ms::Template(source), &context);
+}
+
+/**
+ * Memoized sections render as without memoization, including filters, which
+ * render their body in the enclosing context.
+ */
+static void testMemoization()
+{
+    ms::Value model;
+    ms::Value::list_t values;
+    ms::Value::list_t items;
+    for (int i = 0; i < 6; ++i) {
+        values.push_back("v" + std::to_string(i));
+        ms::Value item;
+        item["name"] = i % 2 ? "odd" : "even";
+        items.push_back(item);
+    }
+    model["values"] = values;
+    model["items"] = items;
+    protocdoc::addFilters(&model);
+
+    const char *sources[] = {
+        "{{#values}}[{{#nobr}}{{.}}{{/nobr}}]{{/values}}",
+        "{{#values}}[{{#p}}{{.}}{{/p}}]{{/values}}",
+        "{{#items}}[{{#nobr}}{{name}}{{/nobr}}]{{/items}}",
+        "{{#items}}[{{#name}}{{.}}{{/name}}]{{/items}}",
+        "{{#items}}{{#values}}{{.}}{{/values}}{{/items}}",
+    };
+    for (const char *source : sources) {
+        CHECK(rendered(source, model, true) == rendered(source, model, false));
+    }
+    CHECK(rendered(sources[0], model, true) == "[v0][v1][v2][v3][v4][v5]");
+}
+
+/**
+ * Names are split into tokens at punctuation, underscores and camel case, and
+ * the parts of a word are also indexed joined.
+ */
+static void testSearchIndexTokens()
+{
+    ms::Value field;
+    field["field_name"] = "vehicle_id";
+    ms::Value message;
+    message["message_long_name"] = "BookingStatus";
+    message["message_full_name"] = "acme.BookingStatus";
+    message["message_fields"] = ms::Value::list_t{field};
+    ms::Value file;
+    file["file_name"] = "booking.proto";
+    file["file_messages"] = ms::Value::list_t{message};
+
+    ms::Value index;
+    std::string error;
+    CHECK(protocdoc::fromJson(protocdoc::searchIndex(ms::Value::list_t{file}), &index, &error));
+    std::vector<std::string> tokens;
+    for (const ms::Value &token : index["tokens"].list()) {
+        tokens.emplace_back(token.text());
+    }
+    for (const char *token : { "booking", "status", "bookingstatus", "vehicle", "id", "vehicleid" }) {
+        CHECK(std::find(tokens.begin(), tokens.end(), token) != tokens.end());
+    }
+    CHECK(std::find(tokens.begin(), tokens.end(), "vehicle_id") == tokens.end());
+}
+
+/**
+ * Returns the value parsed from the JSON @p text, or a null value on error.
+ */
+static ms::Value parsedJson(const std::string &text)
+{
+    ms::Value value;
+    std::string error;
+    if (!protocdoc::fromJson(text, &value, &error)) {
+        return ms::Value();
+    }
+    return value;
+}
+
+/**
+ * Numbers are parsed as integers, or kept as text if they have no integer
+ * value in the model. Malformed numbers are errors.
+ */
+static void testJsonNumbers()
+{
+    CHECK(parsedJson("[42]").list().at(0).toNumber() == 42);
+    CHECK(parsedJson("[-7]").list().at(0).toNumber() == -7);
+    CHECK(parsedJson("[0]").list().at(0).toNumber() == 0);
+    CHECK(parsedJson("[1.5e3]").list().at(0).text() == "1.5e3");
+    CHECK(parsedJson("[99999999999999999999]").list().at(0).text() == "99999999999999999999");
+
+    for (const char *text : { "[-]", "[+1]", "[1.]", "[.5]", "[01]", "[1e]", "[1e+]", "[--1]", "[1-2]" }) {
+        CHECK(parsedJson(text).isNull());
+    }
+}
+
+int main()
+{
+    testScalarSection();
+    testOtherSections();
+    testMemoization();
+    testSearchIndexTokens();
+    testJsonNumbers();
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,41 @@
+# Tests of the protocdoc library. Like the library, they need only the C++
+# standard library and libprotobuf. Run with "make check".
+
+TEMPLATE = app
+TARGET = protocdoc-tests
+
+CONFIG += console c++17 testcase
+CONFIG -= qt app_bundle
+
+include(../../src/protocdoc/protocdoc.pri)
+
+INCLUDEPATH += ../../src
+SOURCES += main.cpp
+
+linux {
+    # Use pkg-config to find libprotobuf.
+    CONFIG += link_pkgconfig
+    PKGCONFIG = protobuf
+}
+
+msvc|mac {
+    # Get location of protobuf library.
+    PROTOBUF_PREFIX = $$getenv(PROTOBUF_PREFIX)
+    isEmpty(PROTOBUF_PREFIX) {
+        error(You must set the PROTOBUF_PREFIX environment variable!)
+    }
+}
+
+msvc {
+    INCLUDEPATH += "$${PROTOBUF_PREFIX}\src"
+    release:LIBS += "$${PROTOBUF_PREFIX}\vsprojects\Release\libprotobuf.lib"
+    debug:LIBS += "$${PROTOBUF_PREFIX}\vsprojects\Debug\libprotobuf.lib"
+}
+
+mac {
+    INCLUDEPATH += "$${PROTOBUF_PREFIX}/include"
+    LIBS += -L$${PROTOBUF_PREFIX}/lib -lprotobuf
+}
+
+# Increase g++ warnings.
+*g++*:QMAKE_CXXFLAGS += -Werror -Wall -Wextra